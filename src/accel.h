@@ -0,0 +1,81 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* accel.h: Accelerator backend interface (dynamic modules and built-in).
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#ifndef HPCAT_ACCEL_H
+#define HPCAT_ACCEL_H
+
+#include <hwloc.h>
+
+/* Functions exported by an accelerator backend. Dynamic modules provide them
+ * as hpcat_accel_* symbols, built-in backends are linked in the binary. */
+typedef struct AccelBackend
+{
+    const char *name;
+    int (*runtime_load)(void *lib_handle);                           /* Optional */
+    int (*count)(void);
+    int (*pciaddr_list_str)(char *buff, const int max_buff_size);
+    int (*numa_bitmap)(hwloc_bitmap_t numa_affinity);
+    int (*visible_bitmap)(hwloc_bitmap_t bitmap);
+    int (*numa_first)(void);
+    int (*partition_list_str)(char *buff, const int max_buff_size);  /* Optional */
+} AccelBackend;
+
+/* Built-in backend scanning PCIe devices in sysfs (no vendor runtime needed) */
+extern const AccelBackend accel_sysfs_backend;
+
+/* Backends linked in the binary (--enable-static-backends). Their vendor
+ * runtime is still loaded at run time, runtime_load() resolves its symbols
+ * from the handle opened by the node probe. NULL when not built-in. */
+#ifdef HPCAT_STATIC_MOCK
+extern const AccelBackend accel_mock_backend;
+#define ACCEL_MOCK_BACKEND &accel_mock_backend
+#else
+#define ACCEL_MOCK_BACKEND NULL
+#endif
+
+#ifdef HPCAT_STATIC_HIP
+extern const AccelBackend accel_hip_backend;
+#define ACCEL_HIP_BACKEND &accel_hip_backend
+#else
+#define ACCEL_HIP_BACKEND NULL
+#endif
+
+#ifdef HPCAT_STATIC_NVML
+extern const AccelBackend accel_nvml_backend;
+#define ACCEL_NVML_BACKEND &accel_nvml_backend
+#else
+#define ACCEL_NVML_BACKEND NULL
+#endif
+
+#ifdef HPCAT_STATIC_ZE
+extern const AccelBackend accel_ze_backend;
+#define ACCEL_ZE_BACKEND &accel_ze_backend
+#else
+#define ACCEL_ZE_BACKEND NULL
+#endif
+
+#endif /* HPCAT_ACCEL_H */
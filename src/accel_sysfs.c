@@ -0,0 +1,385 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* accel_sysfs.c: Built-in accelerator backend relying on sysfs only.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <hwloc.h>
+
+#include "hpcat.h"
+#include "accel.h"
+#include "common.h"
+
+#define SYSFS_PCI_DEVICES "/sys/bus/pci/devices"
+
+#define PCI_VENDOR_AMD    0x1002
+#define PCI_VENDOR_NVIDIA 0x10de
+#define PCI_VENDOR_INTEL  0x8086
+
+extern hwloc_topology_t topology;
+
+typedef struct
+{
+    unsigned int domain;
+    unsigned int bus;
+    unsigned int dev;
+    unsigned int func;
+    int          vendor_id;  /* Position in sysfs_vendors */
+    int          numa_node;
+    int          index;      /* Device ID as seen by the vendor runtime */
+    bool         is_visible;
+} SysfsDevice;
+
+static SysfsDevice *sysfs_devices = NULL;
+static int sysfs_devices_count = 0;
+static int sysfs_devices_capacity = 0;
+static int sysfs_visible_count = 0;
+static bool sysfs_is_init = false;
+
+/* Environment variable used by each vendor runtime to restrict device visibility,
+ * and kernel drivers exposing the device to that runtime */
+static const struct
+{
+    unsigned int vendor;
+    const char   *visible_env;
+    const char   *drivers[2];
+} sysfs_vendors[] =
+{
+    { PCI_VENDOR_AMD,    "ROCR_VISIBLE_DEVICES", { "amdgpu", NULL } },
+    { PCI_VENDOR_NVIDIA, "CUDA_VISIBLE_DEVICES", { "nvidia", NULL } },
+    { PCI_VENDOR_INTEL,  "ZE_AFFINITY_MASK",     { "i915",   "xe" } },
+};
+
+#define SYSFS_VENDORS_MAX (int)(sizeof(sysfs_vendors) / sizeof(sysfs_vendors[0]))
+
+static int read_hex_file(const char *dev_name, const char *attr, unsigned int *value)
+{
+    char path[PATH_MAX];
+    sysfs_path(path, PATH_MAX - 1, SYSFS_PCI_DEVICES "/%s/%s", dev_name, attr);
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    const int ret = fscanf(file, "%x", value);
+    fclose(file);
+
+    return (ret == 1) ? 0 : -1;
+}
+
+/* 3D and other display controllers, processing accelerators. VGA controllers
+ * are only NVIDIA GPUs, for AMD and Intel they are integrated or BMC GPUs. */
+static bool is_accel_class(const unsigned int class, const unsigned int vendor)
+{
+    const unsigned int base_sub = (class >> 8) & 0xffff;
+
+    return (base_sub == 0x0302) || (base_sub == 0x0380) || (base_sub == 0x1200) ||
+           ((base_sub == 0x0300) && (vendor == PCI_VENDOR_NVIDIA));
+}
+
+/* Compute devices are bound to the vendor driver, AMD ones are also in the KFD topology */
+static bool has_compute_driver(const char *dev_name, const int vendor_id)
+{
+    char path[PATH_MAX], link[PATH_MAX];
+    sysfs_path(path, PATH_MAX - 1, SYSFS_PCI_DEVICES "/%s/driver", dev_name);
+
+    const ssize_t len = readlink(path, link, PATH_MAX - 1);
+    if (len <= 0)
+        return false;
+    link[len] = '\0';
+
+    const char *driver = strrchr(link, '/');
+    driver = (driver != NULL) ? driver + 1 : link;
+
+    bool is_known = false;
+    for (int i = 0; i < 2; i++)
+        if ((sysfs_vendors[vendor_id].drivers[i] != NULL) && (strcmp(driver, sysfs_vendors[vendor_id].drivers[i]) == 0))
+            is_known = true;
+
+    if (is_known && (sysfs_vendors[vendor_id].vendor == PCI_VENDOR_AMD))
+    {
+        sysfs_path(path, PATH_MAX - 1, "/sys/class/kfd/kfd/topology/nodes");
+        is_known = (access(path, F_OK) == 0);
+    }
+
+    return is_known;
+}
+
+static int get_vendor_id(const unsigned int vendor)
+{
+    for (int i = 0; i < SYSFS_VENDORS_MAX; i++)
+        if (sysfs_vendors[i].vendor == vendor)
+            return i;
+
+    return -1;
+}
+
+/* Fallback when the firmware does not report numa_node (e.g. single socket) */
+static int get_numa_from_cpulist(const char *dev_name)
+{
+    char path[PATH_MAX], cpulist[STR_MAX];
+    sysfs_path(path, PATH_MAX - 1, SYSFS_PCI_DEVICES "/%s/local_cpulist", dev_name);
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    char *ret = fgets(cpulist, STR_MAX, file);
+    fclose(file);
+    if (ret == NULL)
+        return -1;
+
+    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+    hwloc_bitmap_t nodeset = hwloc_bitmap_alloc();
+    int numa_node = -1;
+
+    if ((cpuset != NULL) && (nodeset != NULL) && (hwloc_bitmap_list_sscanf(cpuset, cpulist) == 0))
+    {
+        hwloc_cpuset_to_nodeset(topology, cpuset, nodeset);
+        numa_node = hwloc_bitmap_first(nodeset);
+    }
+
+    hwloc_bitmap_free(cpuset);
+    hwloc_bitmap_free(nodeset);
+
+    return numa_node;
+}
+
+static int compare_devices(const void *a, const void *b)
+{
+    const SysfsDevice *da = a, *db = b;
+
+    if (da->domain != db->domain) return (da->domain < db->domain) ? -1 : 1;
+    if (da->bus != db->bus)       return (da->bus < db->bus) ? -1 : 1;
+    if (da->dev != db->dev)       return (da->dev < db->dev) ? -1 : 1;
+    return (da->func < db->func) ? -1 : (da->func > db->func);
+}
+
+static int sysfs_init(void)
+{
+    if (sysfs_is_init)
+        return 0;
+
+    char path[PATH_MAX];
+    sysfs_path(path, PATH_MAX - 1, SYSFS_PCI_DEVICES);
+
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+        return -1;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        unsigned int class, vendor;
+        SysfsDevice dev = { 0 };
+
+        if (sscanf(entry->d_name, "%x:%x:%x.%x", &dev.domain, &dev.bus, &dev.dev, &dev.func) != 4)
+            continue;
+
+        if ((read_hex_file(entry->d_name, "class", &class) != 0) ||
+            (read_hex_file(entry->d_name, "vendor", &vendor) != 0) || !is_accel_class(class, vendor))
+            continue;
+
+        dev.vendor_id = get_vendor_id(vendor);
+        if ((dev.vendor_id < 0) || !has_compute_driver(entry->d_name, dev.vendor_id))
+            continue;
+
+        if (array_grow(&sysfs_devices, &sysfs_devices_capacity, sysfs_devices_count, sizeof(SysfsDevice)) != 0)
+            break;
+
+        dev.numa_node = get_device_numa_affinity(dev.domain, dev.bus);
+        if (dev.numa_node < 0)
+            dev.numa_node = get_numa_from_cpulist(entry->d_name);
+
+        sysfs_devices[sysfs_devices_count++] = dev;
+    }
+
+    closedir(dir);
+
+    /* Vendor runtimes enumerate devices in PCIe order, sort them the same way */
+    qsort(sysfs_devices, sysfs_devices_count, sizeof(SysfsDevice), compare_devices);
+
+    /* Number devices per vendor and apply the vendor visibility mask */
+    for (int v = 0; v < SYSFS_VENDORS_MAX; v++)
+    {
+        hwloc_bitmap_t visible = NULL;
+        char *visible_env = getenv(sysfs_vendors[v].visible_env);
+
+        if (visible_env != NULL)
+        {
+            visible = hwloc_bitmap_alloc();
+            if (visible == NULL)
+                return -1;
+
+            if (strlist_to_bitmap(visible, visible_env) != 0)
+                hwloc_bitmap_zero(visible);
+        }
+
+        int index = 0;
+        for (int i = 0; i < sysfs_devices_count; i++)
+        {
+            SysfsDevice *dev = &sysfs_devices[i];
+            if (dev->vendor_id != v)
+                continue;
+
+            dev->index = index++;
+            dev->is_visible = (visible == NULL) || hwloc_bitmap_isset(visible, dev->index);
+            if (dev->is_visible)
+                sysfs_visible_count++;
+        }
+
+        if (visible != NULL)
+            hwloc_bitmap_free(visible);
+    }
+
+    sysfs_is_init = true;
+    return 0;
+}
+
+/**
+ * Retrieve how many accelerators are visible from this context
+ *
+ * @return                   Quantity of devices found or -1
+ */
+static int sysfs_accel_count(void)
+{
+    if (sysfs_init() != 0)
+        return -1;
+
+    return sysfs_visible_count;
+}
+
+/**
+ *  Format a list (comma separated) of the PCIe addresses of all
+ *  visible accelerators.
+ *
+ * @param   buff[out]          Output buffer for the list of addresses
+ * @param   max_buff_size[in]  Size of the buffer
+ * @return                     Success: 0, Error: -1
+ */
+static int sysfs_accel_pciaddr_list_str(char *buff, const int max_buff_size)
+{
+    if (sysfs_accel_count() <= 0)
+        return -1;
+
+    int max_size = max_buff_size - 1;
+
+    for (int i = 0; i < sysfs_devices_count; i++)
+    {
+        SysfsDevice *dev = &sysfs_devices[i];
+        char pci[PCI_STR_MAX] = { 0 };
+
+        if (!dev->is_visible)
+            continue;
+
+        snprintf(pci, PCI_STR_MAX - 1, "%s[%01x:%02x]", (buff[0] == '\0') ? "" : ",",
+                                                        dev->domain, dev->bus);
+
+        strncat(buff, pci, max_size);
+        max_size -= strlen(pci);
+        if (max_size <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Retrive a list of visible devices in a bitmap
+ *
+ * @param   bitmap[out]   Preallocated hwloc bitmap
+ * @return                Success: 0, Error: -1
+ */
+static int sysfs_accel_visible_bitmap(hwloc_bitmap_t bitmap)
+{
+    if (sysfs_init() != 0)
+        return -1;
+
+    for (int i = 0; i < sysfs_devices_count; i++)
+        if (sysfs_devices[i].is_visible)
+            hwloc_bitmap_set(bitmap, sysfs_devices[i].index);
+
+    return 0;
+}
+
+/**
+ * Retrieve the NUMA affinity of the first visible accelerator
+ *
+ * @return                      Success: NUMA node, Error: -1
+ */
+static int sysfs_accel_numa_first(void)
+{
+    if (sysfs_accel_count() <= 0)
+        return -1;
+
+    for (int i = 0; i < sysfs_devices_count; i++)
+        if (sysfs_devices[i].is_visible)
+            return sysfs_devices[i].numa_node;
+
+    return -1;
+}
+
+/**
+ * Retrieve a bitmap representing NUMA affinities of all visible accelerators
+ *
+ * @param   numa_affinity[out]  Preallocated hwloc bitmap
+ * @return                      Success: 0, Error: -1
+ */
+static int sysfs_accel_numa_bitmap(hwloc_bitmap_t numa_affinity)
+{
+    if (sysfs_accel_count() <= 0)
+        return -1;
+
+    for (int i = 0; i < sysfs_devices_count; i++)
+    {
+        SysfsDevice *dev = &sysfs_devices[i];
+
+        if (!dev->is_visible)
+            continue;
+
+        if (dev->numa_node == -1)
+            return -1;
+
+        hwloc_bitmap_set(numa_affinity, dev->numa_node);
+    }
+
+    return 0;
+}
+
+const AccelBackend accel_sysfs_backend =
+{
+    .name             = "sysfs",
+    .count            = sysfs_accel_count,
+    .pciaddr_list_str = sysfs_accel_pciaddr_list_str,
+    .numa_bitmap      = sysfs_accel_numa_bitmap,
+    .visible_bitmap   = sysfs_accel_visible_bitmap,
+    .numa_first       = sysfs_accel_numa_first,
+};
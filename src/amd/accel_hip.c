@@ -26,9 +26,334 @@
 ******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
 #include <hwloc.h>
 #include <hip/hip_runtime.h>
 #include "common.h"
+#include "dynload.h"
+#include "accel.h"
+
+/* Runtime functions, resolved with dlsym when built in the hpcat binary */
+#define HIP_SYMBOLS(X) \
+        X(hipGetDeviceCount) \
+        X(hipGetDeviceProperties)
+
+HIP_SYMBOLS(DYNLOAD_DECLARE)
+
+#define KFD_NODES_PATH   "/sys/class/kfd/kfd/topology/nodes"
+#define KFD_ENV          "HPCAT_AMD_KFD"
+#define KFD_LINK_XGMI    11
+#define KFD_WEIGHT_OAM   15   /* XGMI weight between two GCDs of the same package (MI250X) */
+
+typedef struct
+{
+    unsigned int domain;
+    unsigned int bus;
+    char         partition[PCI_STR_MAX];
+} HipDevice;
+
+typedef struct
+{
+    int                node;
+    int                package_first;  /* First KFD node of the package */
+    unsigned long long location;
+    unsigned long long domain;
+    unsigned long long unique_id;      /* ROCr reports it as "GPU-<hex>" UUID */
+} KfdGpu;
+
+static HipDevice *hip_devices = NULL;
+static int hip_devices_count = 0;
+static bool hip_is_init = false;
+
+/* All GPU agents (KFD order) */
+static KfdGpu *kfd_gpus = NULL;
+static int kfd_gpu_count = 0;
+static int kfd_gpu_capacity = 0;
+
+/* Read the value of a key in a KFD properties file */
+static int kfd_read_property(const int node, const char *key, unsigned long long *value)
+{
+    char path[PATH_MAX], line[PATH_MAX];
+    sysfs_path(path, PATH_MAX - 1, KFD_NODES_PATH "/%d/properties", node);
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    int ret = -1;
+    const size_t key_len = strlen(key);
+    while (fgets(line, PATH_MAX, file) != NULL)
+    {
+        if ((strncmp(line, key, key_len) == 0) && (line[key_len] == ' '))
+        {
+            *value = strtoull(line + key_len + 1, NULL, 10);
+            ret = 0;
+            break;
+        }
+    }
+
+    fclose(file);
+    return ret;
+}
+
+/* Read a single value in a sysfs file */
+static int read_sysfs_str(const char *path, char *value, const int max_len)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    char *ret = fgets(value, max_len, file);
+    fclose(file);
+    if (ret == NULL)
+        return -1;
+
+    value[strcspn(value, "\n")] = '\0';
+    return 0;
+}
+
+/* Resolve a ROCr UUID (GPU-<unique_id in hex>) to the index of the GPU agent */
+static int kfd_resolve_uuid(const char *id)
+{
+    unsigned long long unique_id;
+    char *endptr;
+
+    if (strncmp(id, "GPU-", 4) != 0)
+        return -1;
+
+    unique_id = strtoull(id + 4, &endptr, 16);
+    if (*endptr != '\0')
+        return -1;
+
+    for (int i = 0; i < kfd_gpu_count; i++)
+        if (kfd_gpus[i].unique_id == unique_id)
+            return i;
+
+    return -1;
+}
+
+/* Devices visible to HIP, by GPU agent index (KFD order). ROCr applies ROCR_VISIBLE_DEVICES
+ * first, then HIP applies HIP_VISIBLE_DEVICES (or CUDA_VISIBLE_DEVICES) on top of it, with
+ * indexes relative to the devices left by ROCr. */
+static int hip_visible_mask(hwloc_bitmap_t bitmap, const int agent_count)
+{
+    char *rocr_env = getenv("ROCR_VISIBLE_DEVICES");
+    if (rocr_env == NULL)
+        set_first_bits_bitmap(bitmap, agent_count);
+    else if (strlist_to_bitmap_resolve(bitmap, rocr_env, kfd_resolve_uuid) != 0)
+        return -1;
+
+    char *hip_env = getenv("HIP_VISIBLE_DEVICES");
+    if (hip_env == NULL)
+        hip_env = getenv("CUDA_VISIBLE_DEVICES");
+    if (hip_env == NULL)
+        return 0;
+
+    hwloc_bitmap_t hip_mask = hwloc_bitmap_alloc();
+    hwloc_bitmap_t rocr_mask = hwloc_bitmap_dup(bitmap);
+    if ((hip_mask == NULL) || (rocr_mask == NULL) || (strlist_to_bitmap(hip_mask, hip_env) != 0))
+    {
+        hwloc_bitmap_free(hip_mask);
+        hwloc_bitmap_free(rocr_mask);
+        return -1;
+    }
+
+    int id, index = 0;
+    hwloc_bitmap_zero(bitmap);
+    hwloc_bitmap_foreach_begin(id, rocr_mask)
+    {
+        if (hwloc_bitmap_isset(hip_mask, index++))
+            hwloc_bitmap_set(bitmap, id);
+    }
+    hwloc_bitmap_foreach_end();
+
+    hwloc_bitmap_free(hip_mask);
+    hwloc_bitmap_free(rocr_mask);
+    return 0;
+}
+
+/* First GPU node (lowest KFD node id) in the same package as this node */
+static int kfd_package_first_node(const int node)
+{
+    int first = node;
+
+    for (int link = 0; ; link++)
+    {
+        char path[PATH_MAX], line[PATH_MAX];
+        unsigned long long type = 0, node_to = 0, weight = 0;
+
+        sysfs_path(path, PATH_MAX - 1, KFD_NODES_PATH "/%d/io_links/%d/properties", node, link);
+        FILE *file = fopen(path, "r");
+        if (file == NULL)
+            break;
+
+        while (fgets(line, PATH_MAX, file) != NULL)
+        {
+            sscanf(line, "type %llu", &type);
+            sscanf(line, "node_to %llu", &node_to);
+            sscanf(line, "weight %llu", &weight);
+        }
+        fclose(file);
+
+        if ((type == KFD_LINK_XGMI) && (weight == KFD_WEIGHT_OAM) && ((int)node_to < first))
+            first = (int)node_to;
+    }
+
+    return first;
+}
+
+/**
+ * Discover AMD GPUs from the KFD topology in sysfs, without initializing the
+ * HIP runtime. MI250X GCDs are reported with their package (pkg<P>.gcd<G>),
+ * MI300 partitions with their compute and memory partitioning modes.
+ *
+ * @return                   Success: 0, Error: -1
+ */
+static int kfd_init(void)
+{
+    int count = 0;
+
+    for (int node = 0; ; node++)
+    {
+        unsigned long long simd_count = 0;
+        char path[PATH_MAX], gpu_id[PCI_STR_MAX];
+
+        sysfs_path(path, PATH_MAX - 1, KFD_NODES_PATH "/%d/gpu_id", node);
+        if (read_sysfs_str(path, gpu_id, PCI_STR_MAX) != 0)
+            break;
+
+        /* CPU nodes have no SIMD units */
+        if ((kfd_read_property(node, "simd_count", &simd_count) != 0) || (simd_count == 0) ||
+            (strcmp(gpu_id, "0") == 0))
+            continue;
+
+        if (array_grow(&kfd_gpus, &kfd_gpu_capacity, count, sizeof(KfdGpu)) != 0)
+            return -1;
+
+        KfdGpu *gpu = &kfd_gpus[count];
+        if ((kfd_read_property(node, "location_id", &gpu->location) != 0) ||
+            (kfd_read_property(node, "domain", &gpu->domain) != 0))
+            return -1;
+
+        if (kfd_read_property(node, "unique_id", &gpu->unique_id) != 0)
+            gpu->unique_id = 0;
+
+        gpu->node = node;
+        gpu->package_first = kfd_package_first_node(node);
+        count++;
+    }
+
+    if (count == 0)
+        return -1;
+
+    kfd_gpu_count = count;
+
+    hip_devices = calloc(count, sizeof(HipDevice));
+    if (hip_devices == NULL)
+        return -1;
+
+    /* Apply the visibility masks as the HIP runtime would (GPU agents in KFD order) */
+    hwloc_bitmap_t visible = hwloc_bitmap_alloc();
+    if (visible == NULL)
+        return -1;
+
+    if (hip_visible_mask(visible, count) != 0)
+        hwloc_bitmap_zero(visible);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!hwloc_bitmap_isset(visible, i))
+            continue;
+
+        const KfdGpu *gpu = &kfd_gpus[i];
+        HipDevice *dev = &hip_devices[hip_devices_count++];
+        dev->domain = (unsigned int)gpu->domain;
+        dev->bus = (unsigned int)(gpu->location >> 8) & 0xff;
+
+        /* Position of this GPU among the ones sharing its PCIe device or its package */
+        int partition_id = 0, package_id = 0, gcd_id = 0, package_size = 0;
+        for (int j = 0; j < count; j++)
+        {
+            if (j < i && kfd_gpus[j].location == gpu->location)
+                partition_id++;
+            if (kfd_gpus[j].package_first == kfd_gpus[j].node && kfd_gpus[j].package_first < gpu->package_first)
+                package_id++;
+            if (kfd_gpus[j].package_first == gpu->package_first)
+            {
+                package_size++;
+                if (j < i)
+                    gcd_id++;
+            }
+        }
+
+        char compute_path[PATH_MAX], memory_path[PATH_MAX], compute[PCI_STR_MAX], memory[PCI_STR_MAX];
+        const char *pci_fmt = "/sys/bus/pci/devices/%04x:%02x:%02x.%x/current_%s_partition";
+        const unsigned int slot = (gpu->location >> 3) & 0x1f, func = gpu->location & 0x7;
+
+        sysfs_path(compute_path, PATH_MAX - 1, pci_fmt, dev->domain, dev->bus, slot, func, "compute");
+        sysfs_path(memory_path, PATH_MAX - 1, pci_fmt, dev->domain, dev->bus, slot, func, "memory");
+
+        if ((read_sysfs_str(compute_path, compute, PCI_STR_MAX) == 0) &&
+            (read_sysfs_str(memory_path, memory, PCI_STR_MAX) == 0))
+            snprintf(dev->partition, PCI_STR_MAX - 1, "%s.%d/%s", compute, partition_id, memory);
+        else if (package_size > 1)
+            snprintf(dev->partition, PCI_STR_MAX - 1, "pkg%d.gcd%d", package_id, gcd_id);
+    }
+
+    hwloc_bitmap_free(visible);
+    return 0;
+}
+
+/* Fallback relying on the HIP runtime (slow: initializes all devices) */
+static int hip_runtime_init(void)
+{
+    int dev_count = 0;
+    if (DYNCALL(hipGetDeviceCount)(&dev_count) != hipSuccess)
+        return -1;
+
+    free(hip_devices);
+    hip_devices = calloc(dev_count, sizeof(HipDevice));
+    if ((dev_count > 0) && (hip_devices == NULL))
+        return -1;
+
+    for (int i = 0; i < dev_count; i++)
+    {
+        struct hipDeviceProp_t prop;
+        if (DYNCALL(hipGetDeviceProperties)(&prop, i) != hipSuccess)
+            return -1;
+
+        hip_devices[i].domain = prop.pciDomainID;
+        hip_devices[i].bus = prop.pciBusID;
+        hip_devices[i].partition[0] = '\0';
+        hip_devices_count++;
+    }
+
+    return 0;
+}
+
+static int hip_init(void)
+{
+    if (hip_is_init)
+        return 0;
+
+    /* KFD topology is used unless HPCAT_AMD_KFD=0 */
+    const char *kfd_env = getenv(KFD_ENV);
+    const bool kfd_enabled = (kfd_env == NULL) || (strcmp(kfd_env, "0") != 0);
+
+    hip_devices_count = 0;
+    if (!kfd_enabled || (kfd_init() != 0))
+    {
+        hip_devices_count = 0;
+        if (hip_runtime_init() != 0)
+            return -1;
+    }
+
+    hip_is_init = true;
+    return 0;
+}
 
 /**
  * Retrieve how many AMD devices are available from this context
@@ -37,8 +362,7 @@
  */
 int hpcat_accel_count(void)
 {
-    int dev_count = 0;
-    return (hipGetDeviceCount(&dev_count) == hipSuccess) ? dev_count : -1;
+    return (hip_init() == 0) ? hip_devices_count : -1;
 }
 
 /**
@@ -60,12 +384,9 @@ int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
     for (int i = 0; i < dev_count; i++)
     {
         char pci[PCI_STR_MAX] = { 0 };
-        struct hipDeviceProp_t prop;
-        if (hipGetDeviceProperties(&prop, i) != hipSuccess)
-            return -1;
 
         snprintf(pci, PCI_STR_MAX - 1, "%s[%01x:%02x]", (buff[0] == '\0') ? "" : ",",
-                                                        prop.pciDomainID, prop.pciBusID);
+                                                        hip_devices[i].domain, hip_devices[i].bus);
 
         strncat(buff, pci, max_size);
         max_size -= strlen(pci);
@@ -76,6 +397,45 @@ int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
     return 0;
 }
 
+/**
+ *  Format a list (comma separated) of the partition of all accelerators
+ *  found (GCD within a package or compute/memory partitioning modes).
+ *
+ * @param   buff[out]          Output buffer for the list of partitions
+ * @param   max_buff_size[in]  Size of the buffer
+ * @return                     Success: 0, Error: -1
+ */
+int hpcat_accel_partition_list_str(char *buff, const int max_buff_size)
+{
+    const int dev_count = hpcat_accel_count();
+    if (dev_count <= 0)
+        return -1;
+
+    int max_size = max_buff_size - 1;
+
+    for (int i = 0; i < dev_count; i++)
+    {
+        char partition[PCI_STR_MAX + 1] = { 0 };
+
+        /* Nothing to report if partitions are unknown (e.g. HIP runtime fallback) */
+        if (hip_devices[i].partition[0] == '\0')
+        {
+            buff[0] = '\0';
+            return 0;
+        }
+
+        snprintf(partition, PCI_STR_MAX, "%s%s", (buff[0] == '\0') ? "" : ",",
+                                                 hip_devices[i].partition);
+
+        strncat(buff, partition, max_size);
+        max_size -= strlen(partition);
+        if (max_size <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 /**
  * Retrive a list of visible devices in a bitmap
  *
@@ -84,15 +444,23 @@ int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
  */
 int hpcat_accel_visible_bitmap(hwloc_bitmap_t bitmap)
 {
-    char *visible_env = getenv("ROCR_VISIBLE_DEVICES");
+    const int dev_count = hpcat_accel_count();
+    if (dev_count < 0)
+        return -1;
+
+    /* Agents are unknown with the HIP runtime fallback, which reports the visible devices only */
+    if (hip_visible_mask(bitmap, (kfd_gpu_count > 0) ? kfd_gpu_count : MAX_DEVICE_ID) != 0)
+        return -1;
 
-    if (visible_env == NULL)
+    int id, index = 0;
+    hwloc_bitmap_foreach_begin(id, bitmap)
     {
-        set_first_bits_bitmap(bitmap, hpcat_accel_count());
-        return 0;
+        if (index++ >= dev_count)
+            hwloc_bitmap_clr(bitmap, id);
     }
-    else
-        return strlist_to_bitmap(bitmap, visible_env);
+    hwloc_bitmap_foreach_end();
+
+    return 0;
 }
 
 /**
@@ -106,11 +474,7 @@ int hpcat_accel_numa_first(void)
     if (dev_count <= 0)
         return -1;
 
-    struct hipDeviceProp_t prop;
-    if (hipGetDeviceProperties(&prop, 0) != hipSuccess)
-        return -1;
-
-    return get_device_numa_affinity(prop.pciDomainID, prop.pciBusID);
+    return get_device_numa_affinity(hip_devices[0].domain, hip_devices[0].bus);
 }
 
 /**
@@ -127,11 +491,7 @@ int hpcat_accel_numa_bitmap(hwloc_bitmap_t numa_affinity)
 
     for (int i = 0; i < dev_count; i++)
     {
-        struct hipDeviceProp_t prop;
-        if (hipGetDeviceProperties(&prop, i) != hipSuccess)
-            return -1;
-
-        const int numa_node = get_device_numa_affinity(prop.pciDomainID, prop.pciBusID);
+        const int numa_node = get_device_numa_affinity(hip_devices[i].domain, hip_devices[i].bus);
         if (numa_node == -1)
             return -1;
 
@@ -140,3 +500,23 @@ int hpcat_accel_numa_bitmap(hwloc_bitmap_t numa_affinity)
 
     return 0;
 }
+
+#ifdef HPCAT_STATIC_BACKEND
+static int hip_runtime_load(void *lib_handle)
+{
+    HIP_SYMBOLS(DYNLOAD_RESOLVE)
+    return 0;
+}
+
+const AccelBackend HPCAT_STATIC_BACKEND =
+{
+    .name               = "libhpcathip.so (built-in)",
+    .runtime_load       = hip_runtime_load,
+    .count              = hpcat_accel_count,
+    .pciaddr_list_str   = hpcat_accel_pciaddr_list_str,
+    .numa_bitmap        = hpcat_accel_numa_bitmap,
+    .visible_bitmap     = hpcat_accel_visible_bitmap,
+    .numa_first         = hpcat_accel_numa_first,
+    .partition_list_str = hpcat_accel_partition_list_str,
+};
+#endif
@@ -0,0 +1,509 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* hpcat_bench.c: Scalability simulator, measuring the rank 0 side of hpcat on
+*                synthetic jobs without any allocation.
+*
+* Task records are built from a hwloc topology (synthetic description or saved
+* XML) replicated on every simulated node, then packed/unpacked as done by the
+* gather, checked for hints and rendered (table and YAML) in-process.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <argp.h>
+#include <sys/resource.h>
+#include <hwloc.h>
+
+#include "hpcat.h"
+#include "common.h"
+#include "hint.h"
+#include "output.h"
+#include "outbuf.h"
+#include "pcie.h"
+#include "task.h"
+
+#define DEFAULT_TOPOLOGY "pack:1 numa:4 l3:2 core:8 pu:2"  /* 64 cores, 8 L3 (CCD) */
+#define BENCH_SEED       42
+
+/* Used by pcie.c (package of a NUMA node) */
+hwloc_topology_t topology;
+
+typedef struct
+{
+    int         num_nodes;
+    int         ranks_per_node;
+    int         num_threads;
+    int         gpus_per_node;
+    int         nics_per_node;
+    double      hint_density;   /* Fraction of tasks with a binding issue */
+    int         iterations;
+    const char *topology;       /* Synthetic description or XML file */
+    const char *output;         /* Rendered output (discarded by default) */
+    bool        enable_stdout;
+    bool        enable_yaml;
+} BenchSettings;
+
+typedef struct
+{
+    const char *name;
+    double      seconds;        /* Total over all iterations */
+    long        peak_rss_kb;    /* Peak resident set size at the end of the stage */
+} BenchStage;
+
+static char doc[] = "Simulate the collection and the rendering of hpcat results for a synthetic "
+                    "job (no MPI or hardware required) and report the cost of each stage.";
+
+static struct argp_option options[] =
+{
+    {"nodes",          'n', "N",     0,  "Simulated nodes (default: 16)"},
+    {"ranks-per-node", 'r', "N",     0,  "MPI ranks per node (default: 8)"},
+    {"threads",        't', "N",     0,  "OpenMP threads per rank (default: 1)"},
+    {"gpus",           'g', "N",     0,  "GPUs per node (default: 8)"},
+    {"nics",           'k', "N",     0,  "NICs per node (default: 4)"},
+    {"hint-density",   'd', "RATIO", 0,  "Fraction of tasks with binding issues (default: 0.1)"},
+    {"iterations",     'i', "N",     0,  "Repetitions of each stage (default: 1)"},
+    {"topology",       'T', "DESC",  0,  "hwloc synthetic topology or XML file"},
+    {"output",         'o', "FILE",  0,  "Keep the rendered output in FILE"},
+    {"stdout-only",    11,  0,       0,  "Only render the table"},
+    {"yaml-only",      12,  0,       0,  "Only render YAML"},
+    {0}
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+    BenchSettings *settings = (BenchSettings *)state->input;
+
+    switch (key)
+    {
+        case 'n':
+            settings->num_nodes = atoi(arg);
+            break;
+        case 'r':
+            settings->ranks_per_node = atoi(arg);
+            break;
+        case 't':
+            settings->num_threads = atoi(arg);
+            break;
+        case 'g':
+            settings->gpus_per_node = atoi(arg);
+            break;
+        case 'k':
+            settings->nics_per_node = atoi(arg);
+            break;
+        case 'd':
+            settings->hint_density = atof(arg);
+            break;
+        case 'i':
+            settings->iterations = atoi(arg);
+            break;
+        case 'T':
+            settings->topology = arg;
+            break;
+        case 'o':
+            settings->output = arg;
+            break;
+        case 11:
+            settings->enable_yaml = false;
+            break;
+        case 12:
+            settings->enable_stdout = false;
+            break;
+        case ARGP_KEY_END:
+            if ((settings->num_nodes <= 0) || (settings->ranks_per_node <= 0) ||
+                (settings->num_threads <= 0) || (settings->iterations <= 0) ||
+                (settings->gpus_per_node < 0) || (settings->nics_per_node < 0))
+                argp_error(state, "counts must be positive");
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static struct argp argp = { options, parse_opt, NULL, doc };
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+static void topology_load(const char *desc)
+{
+    const size_t len = strlen(desc);
+    int ret;
+
+    if (hwloc_topology_init(&topology) != 0)
+        FATAL("Error: unable to initialize hwloc. Exiting.\n");
+
+    if ((len > 4) && (strcmp(desc + len - 4, ".xml") == 0))
+        ret = hwloc_topology_set_xml(topology, desc);
+    else
+        ret = hwloc_topology_set_synthetic(topology, desc);
+
+    if ((ret != 0) || (hwloc_topology_load(topology) != 0))
+        FATAL("Error: unable to load topology \"%s\". Exiting.\n", desc);
+}
+
+/* Same conversion as get_cpu_numa_affinity(), from an arbitrary set of PUs */
+static void affinity_from_cpuset(Affinity *affinity, hwloc_const_cpuset_t cpuset, hwloc_bitmap_t tmp)
+{
+    const int depth_core = hwloc_get_type_depth(topology, HWLOC_OBJ_CORE);
+    const int depth_node = hwloc_get_type_depth(topology, HWLOC_OBJ_NUMANODE);
+
+    serialize_bitmap(&affinity->hw_thread_affinity, (hwloc_bitmap_t)cpuset);
+
+    hwloc_bitmap_zero(tmp);
+    for (int i = 0; i < hwloc_get_nbobjs_by_depth(topology, depth_core); i++)
+    {
+        hwloc_obj_t core = hwloc_get_obj_by_depth(topology, depth_core, i);
+        if (hwloc_bitmap_intersects(cpuset, core->cpuset))
+            hwloc_bitmap_set(tmp, core->first_child->os_index);
+    }
+    serialize_bitmap(&affinity->core_affinity, tmp);
+
+    hwloc_bitmap_zero(tmp);
+    for (int i = 0; i < hwloc_get_nbobjs_by_depth(topology, depth_node); i++)
+    {
+        hwloc_obj_t node = hwloc_get_obj_by_depth(topology, depth_node, i);
+        if (hwloc_bitmap_intersects(cpuset, node->cpuset))
+            hwloc_bitmap_set(tmp, i);
+    }
+    serialize_bitmap(&affinity->numa_affinity, tmp);
+}
+
+/**
+ * Build the record of a task as hpcat_init() would on a node of the topology.
+ * Cores are split evenly between the ranks of a node, GPUs and NICs are
+ * spread over the NUMA nodes. Tasks with a binding issue get the first core of
+ * the next rank and a GPU attached to another NUMA node.
+ *
+ * @param   settings[in]    Benchmark settings
+ * @param   task[out]       Task record (zeroed)
+ * @param   id[in]          Rank
+ * @param   has_issue[in]   Inject binding issues
+ */
+static void task_build(const BenchSettings *settings, Task *task, const int id, const bool has_issue)
+{
+    const int node = id / settings->ranks_per_node;
+    const int local_id = id % settings->ranks_per_node;
+    const int num_cores = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_CORE);
+    const int num_numa = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_NUMANODE);
+    const int cores_per_rank = (num_cores > settings->ranks_per_node) ? num_cores / settings->ranks_per_node : 1;
+
+    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+    hwloc_bitmap_t tmp = hwloc_bitmap_alloc();
+    if ((cpuset == NULL) || (tmp == NULL))
+        FATAL("Error: unable to allocate a hwloc bitmap. Exiting.\n");
+
+    task->id = id;
+    task->is_first_rank = (id == 0);
+    task->is_last_rank = (id == settings->num_nodes * settings->ranks_per_node - 1);
+    task->is_first_node_rank = (local_id == 0);
+    snprintf(task->hostname, HOST_NAME_MAX, "nid%06d", node);
+    task->fabric_group_id = node / 128;
+
+    /* CPU affinity */
+    const int first_core = (local_id * cores_per_rank) % num_cores;
+    for (int i = 0; i < cores_per_rank + (has_issue ? 1 : 0); i++)
+    {
+        hwloc_obj_t core = hwloc_get_obj_by_type(topology, HWLOC_OBJ_CORE, (first_core + i) % num_cores);
+        hwloc_bitmap_or(cpuset, cpuset, core->cpuset);
+    }
+    affinity_from_cpuset(&task->affinity, cpuset, tmp);
+
+    /* OpenMP threads, one hardware thread each */
+    if (settings->num_threads > 1)
+    {
+        task->threads = calloc(settings->num_threads, sizeof(Thread));
+        if (task->threads == NULL)
+            FATAL("Error: unable to allocate threads. Exiting.\n");
+
+        task->num_threads = settings->num_threads;
+        const int weight = hwloc_bitmap_weight(cpuset);
+        for (int i = 0; i < task->num_threads; i++)
+        {
+            hwloc_bitmap_t thread_cpuset = hwloc_bitmap_alloc();
+            int pu = hwloc_bitmap_first(cpuset);
+            for (int j = 0; j < i % weight; j++)
+                pu = hwloc_bitmap_next(cpuset, pu);
+
+            hwloc_bitmap_only(thread_cpuset, pu);
+            task->threads[i].id = i;
+            affinity_from_cpuset(&task->threads[i].affinity, thread_cpuset, tmp);
+            hwloc_bitmap_free(thread_cpuset);
+        }
+    }
+
+    /* NIC: ranks of a node share the NICs in order */
+    if (settings->nics_per_node > 0)
+    {
+        const int nic = local_id * settings->nics_per_node / settings->ranks_per_node;
+
+        task->nic.num_nic = 1;
+        snprintf(task->nic.name, NIC_LIST_MAX, "cxi%d", nic);
+        hwloc_bitmap_only(tmp, nic * num_numa / settings->nics_per_node);
+        serialize_bitmap(&task->nic.numa_affinity, tmp);
+        task->nic.gpu_path = PCIE_PATH_UNKNOWN;
+    }
+
+    /* GPUs: the ones attached to the NUMA node of the rank, another one on issue */
+    if (settings->gpus_per_node > 0)
+    {
+        const int gpus_per_rank = (settings->gpus_per_node > settings->ranks_per_node) ?
+                                  settings->gpus_per_node / settings->ranks_per_node : 1;
+        const int first_gpu = (local_id * settings->gpus_per_node / settings->ranks_per_node +
+                               (has_issue ? settings->gpus_per_node / 2 : 0)) % settings->gpus_per_node;
+        hwloc_bitmap_t numa = hwloc_bitmap_alloc();
+        int len = 0;
+
+        hwloc_bitmap_zero(tmp);
+        for (int i = 0; i < gpus_per_rank; i++)
+        {
+            const int gpu = (first_gpu + i) % settings->gpus_per_node;
+
+            hwloc_bitmap_set(tmp, gpu);
+            hwloc_bitmap_set(numa, gpu * num_numa / settings->gpus_per_node);
+            len += snprintf(task->accel.pciaddr + len, STR_MAX - len, "%s[0:%02x]",
+                            (i == 0) ? "" : ",", 0xc1 + gpu * 8);
+        }
+
+        task->accel.num_accel = gpus_per_rank;
+        serialize_bitmap(&task->accel.visible_devices, tmp);
+        serialize_bitmap(&task->accel.numa_affinity, numa);
+        hwloc_bitmap_free(numa);
+    }
+
+    hwloc_bitmap_free(cpuset);
+    hwloc_bitmap_free(tmp);
+}
+
+/* Pack all records in a single buffer and unpack them, as the gather does */
+static Task *stage_gather(Hpcat *hpcat, Task *tasks, size_t *total)
+{
+    size_t *displs = malloc(hpcat->num_tasks * sizeof(size_t));
+    Task *gathered = calloc(hpcat->num_tasks, sizeof(Task));
+    if ((displs == NULL) || (gathered == NULL))
+        FATAL("Error: unable to allocate tasks buffer. Exiting.\n");
+
+    *total = 0;
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        displs[i] = *total;
+        *total += hpcat_task_pack_size(&tasks[i]);
+    }
+
+    char *records = malloc(*total);
+    if (records == NULL)
+        FATAL("Error: unable to allocate tasks buffer. Exiting.\n");
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+        hpcat_task_pack(&tasks[i], records + displs[i]);
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+        hpcat_task_unpack(&gathered[i], records + displs[i]);
+
+    free(records);
+    free(displs);
+
+    return gathered;
+}
+
+static void stage_hints(Hpcat *hpcat, Task *tasks)
+{
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        tasks[i].detected_hints = 0;
+        hpcat_hint_task_check(hpcat, &tasks[i]);
+    }
+}
+
+/* Same loop as render() in hpcat.c, the output being written to output_fd */
+static void stage_render(Hpcat *hpcat, Task *tasks, const OutputType_t type, const int output_fd)
+{
+    hpcat_out_init(&hpcat->out, output_fd);
+
+    hpcat->settings.output_type = type;
+    hpcat->detected_hints = 0;
+    hpcat->num_omp_threads = 0;
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        if (hpcat->settings.enable_omp)
+            hpcat->num_omp_threads += tasks[i].num_threads;
+
+        hpcat_hint_global_check(hpcat, &tasks[i]);
+
+        if (type == YAML)
+            hpcat_display_yaml(hpcat, &tasks[i]);
+        else
+            hpcat_display_stdout(hpcat, &tasks[i]);
+    }
+
+    hpcat_out_flush(&hpcat->out);
+    hpcat_out_free(&hpcat->out);
+}
+
+static void report(const BenchSettings *settings, const Hpcat *hpcat, const BenchStage *stages,
+                   const int num_stages, const size_t gathered_bytes)
+{
+    printf("Synthetic job: %d nodes x %d ranks (%d tasks), %d thread(s)/rank, %d GPU(s) and %d NIC(s)/node\n",
+           settings->num_nodes, settings->ranks_per_node, hpcat->num_tasks, settings->num_threads,
+           settings->gpus_per_node, settings->nics_per_node);
+    printf("Topology: \"%s\", hint density: %.2f, iterations: %d\n", settings->topology,
+           settings->hint_density, settings->iterations);
+    printf("Gathered records: %zu bytes (%.1f bytes/task)\n\n", gathered_bytes,
+           (double)gathered_bytes / hpcat->num_tasks);
+
+    printf("%-10s %14s %14s %16s %14s\n", "STAGE", "TOTAL (s)", "ITER (ms)", "TASKS/s", "PEAK RSS (MB)");
+    for (int i = 0; i < num_stages; i++)
+    {
+        const int iterations = (i == 0) ? 1 : settings->iterations;
+        const double iter = stages[i].seconds / iterations;
+
+        printf("%-10s %14.6f %14.3f %16.0f %14.1f\n", stages[i].name, stages[i].seconds, iter * 1e3,
+               (iter > 0) ? hpcat->num_tasks / iter : 0.0, stages[i].peak_rss_kb / 1024.0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    BenchSettings settings =
+    {
+        .num_nodes      = 16,
+        .ranks_per_node = 8,
+        .num_threads    = 1,
+        .gpus_per_node  = 8,
+        .nics_per_node  = 4,
+        .hint_density   = 0.1,
+        .iterations     = 1,
+        .topology       = DEFAULT_TOPOLOGY,
+        .output         = "/dev/null",
+        .enable_stdout  = true,
+        .enable_yaml    = true,
+    };
+
+    argp_parse(&argp, argc, argv, 0, 0, &settings);
+    topology_load(settings.topology);
+
+    Hpcat hpcat = { 0 };
+    hpcat.settings.enable_accel = (settings.gpus_per_node > 0);
+    hpcat.settings.enable_nic = (settings.nics_per_node > 0);
+    hpcat.settings.enable_omp = (settings.num_threads > 1);
+    hpcat.settings.enable_fabric = true;
+    hpcat.settings.enable_hints = true;
+    hpcat.settings.enable_banner = true;
+    hpcat.num_nodes = settings.num_nodes;
+    hpcat.num_tasks = settings.num_nodes * settings.ranks_per_node;
+    hpcat.num_fabric_groups = (settings.num_nodes + 127) / 128;
+    snprintf(hpcat.mpi_version, MPI_MAX_LIBRARY_VERSION_STRING, "hpcat_bench (synthetic job)");
+
+    const int output_fd = open(settings.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0)
+        FATAL("Error: unable to open %s. Exiting.\n", settings.output);
+
+    BenchStage stages[5];
+    int num_stages = 0;
+    double start;
+
+    /* Task records as built by each rank */
+    Task *tasks = calloc(hpcat.num_tasks, sizeof(Task));
+    if (tasks == NULL)
+        FATAL("Error: unable to allocate tasks. Exiting.\n");
+
+    unsigned int seed = BENCH_SEED;
+    start = now();
+    for (int i = 0; i < hpcat.num_tasks; i++)
+        task_build(&settings, &tasks[i], i, rand_r(&seed) < settings.hint_density * RAND_MAX);
+    stages[num_stages++] = (BenchStage){ "build", now() - start, peak_rss_kb() };
+
+    /* Records as received by rank 0 */
+    Task *gathered = NULL;
+    size_t gathered_bytes = 0;
+    start = now();
+    for (int it = 0; it < settings.iterations; it++)
+    {
+        if (gathered != NULL)
+        {
+            for (int i = 0; i < hpcat.num_tasks; i++)
+                hpcat_task_free(&gathered[i]);
+            free(gathered);
+        }
+
+        gathered = stage_gather(&hpcat, tasks, &gathered_bytes);
+    }
+    stages[num_stages++] = (BenchStage){ "gather", now() - start, peak_rss_kb() };
+
+    start = now();
+    for (int it = 0; it < settings.iterations; it++)
+        stage_hints(&hpcat, gathered);
+    stages[num_stages++] = (BenchStage){ "hints", now() - start, peak_rss_kb() };
+
+    if (settings.enable_stdout)
+    {
+        start = now();
+        for (int it = 0; it < settings.iterations; it++)
+            stage_render(&hpcat, gathered, STDOUT, output_fd);
+        stages[num_stages++] = (BenchStage){ "stdout", now() - start, peak_rss_kb() };
+    }
+
+    if (settings.enable_yaml)
+    {
+        start = now();
+        for (int it = 0; it < settings.iterations; it++)
+            stage_render(&hpcat, gathered, YAML, output_fd);
+        stages[num_stages++] = (BenchStage){ "yaml", now() - start, peak_rss_kb() };
+    }
+
+    close(output_fd);
+    report(&settings, &hpcat, stages, num_stages, gathered_bytes);
+
+    for (int i = 0; i < hpcat.num_tasks; i++)
+    {
+        hpcat_task_free(&tasks[i]);
+        hpcat_task_free(&gathered[i]);
+    }
+    free(tasks);
+    free(gathered);
+    hwloc_topology_destroy(topology);
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+#!/bin/bash
+################################################################################
+#                                                                              #
+# (C) Copyright 2025 Hewlett Packard Enterprise Development LP                 #
+#                                                                              #
+#  Permission is hereby granted, free of charge, to any person obtaining a     #
+#  copy of this software and associated documentation files (the "Software"),  #
+#  to deal in the Software without restriction, including without limitation   #
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,    #
+#  and/or sell copies of the Software, and to permit persons to whom the       #
+#  Software is furnished to do so, subject to the following conditions:        #
+#                                                                              #
+#  The above copyright notice and this permission notice shall be included     #
+#  in all copies or substantial portions of the Software.                      #
+#                                                                              #
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR  #
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,    #
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL    #
+#  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR        #
+#  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,       #
+#  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR       #
+#  OTHER DEALINGS IN THE SOFTWARE.                                             #
+#                                                                              #
+################################################################################
+# hpcat_scaling.sh: run hpcat under a local MPI launcher at increasing rank    #
+# counts, record wall time, rank 0 peak RSS and gathered bytes in a CSV file,  #
+# and fail when the largest run exceeds a budget.                              #
+#                                                                              #
+# Usage: hpcat_scaling.sh [OPTIONS] HPCAT_BINARY                               #
+#   --mpirun=CMD          MPI launcher (default: mpirun)                       #
+#   --mpirun-flags=FLAGS  Extra launcher flags (default: --oversubscribe)      #
+#   --ranks="N N ..."     Rank counts (default: "1 2 4 8 16")                  #
+#   --topology=TOPO       hwloc synthetic description, XML file or copy of a   #
+#                         sysfs tree (HPCAT_SYSFS_ROOT)                        #
+#   --csv=FILE            Output CSV (default: hpcat_scaling.csv)              #
+#   --max-seconds=S       Budget: wall time of the largest run                 #
+#   --max-rss-mb=MB       Budget: rank 0 peak RSS of the largest run           #
+#   --max-bytes-per-rank=B  Budget: gathered bytes per rank                    #
+#   --hpcat-flags=FLAGS   Extra hpcat flags (e.g. --mpi-sessions)              #
+#                                                                              #
+# A budget of 0 is not checked.                                                #
+################################################################################
+
+MPIRUN="mpirun"
+MPIRUN_FLAGS="--oversubscribe"
+RANKS="1 2 4 8 16"
+TOPOLOGY=""
+CSV="hpcat_scaling.csv"
+MAX_SECONDS=0
+MAX_RSS_MB=0
+MAX_BYTES_PER_RANK=0
+HPCAT_FLAGS=""
+HPCAT=""
+
+for arg in "$@"; do
+    case "${arg}" in
+        --mpirun=*)             MPIRUN="${arg#*=}" ;;
+        --mpirun-flags=*)       MPIRUN_FLAGS="${arg#*=}" ;;
+        --ranks=*)              RANKS="${arg#*=}" ;;
+        --topology=*)           TOPOLOGY="${arg#*=}" ;;
+        --csv=*)                CSV="${arg#*=}" ;;
+        --max-seconds=*)        MAX_SECONDS="${arg#*=}" ;;
+        --max-rss-mb=*)         MAX_RSS_MB="${arg#*=}" ;;
+        --max-bytes-per-rank=*) MAX_BYTES_PER_RANK="${arg#*=}" ;;
+        --hpcat-flags=*)        HPCAT_FLAGS="${arg#*=}" ;;
+        -*)                     echo "Error: unknown option ${arg}" >&2; exit 2 ;;
+        *)                      HPCAT="${arg}" ;;
+    esac
+done
+
+if [[ ! -x "${HPCAT}" ]]; then
+    echo "Error: hpcat binary not found (${HPCAT})" >&2
+    exit 2
+fi
+
+# Topology seen by every rank, exported to the launcher
+if [[ -z "${TOPOLOGY}" ]]; then
+    :
+elif [[ -d "${TOPOLOGY}" ]]; then
+    export HPCAT_SYSFS_ROOT="${TOPOLOGY}"
+elif [[ "${TOPOLOGY}" == *.xml ]]; then
+    export HWLOC_XMLFILE="${TOPOLOGY}"
+else
+    export HWLOC_SYNTHETIC="${TOPOLOGY}"
+fi
+
+# Open MPI only forwards explicitly listed variables
+ENV_FLAGS=""
+if ${MPIRUN} --version 2>&1 | grep -qiE "Open MPI|OpenRTE"; then
+    for var in HPCAT_SYSFS_ROOT HWLOC_XMLFILE HWLOC_SYNTHETIC; do
+        [[ -v ${var} ]] && ENV_FLAGS="${ENV_FLAGS} -x ${var}"
+    done
+    [[ ${EUID} -eq 0 ]] && ENV_FLAGS="${ENV_FLAGS} --allow-run-as-root"
+fi
+
+echo "ranks,wall_seconds,rank0_peak_rss_kb,gathered_bytes" > "${CSV}"
+
+LOG=$(mktemp)
+trap 'rm -f "${LOG}"' EXIT
+
+for np in ${RANKS}; do
+    start=$(date +%s.%N)
+    if ! ${MPIRUN} ${MPIRUN_FLAGS} ${ENV_FLAGS} -np ${np} "${HPCAT}" ${HPCAT_FLAGS} --verbose --no-banner > /dev/null 2> "${LOG}"; then
+        cat "${LOG}" >&2
+        echo "Error: hpcat failed with ${np} ranks" >&2
+        exit 1
+    fi
+    end=$(date +%s.%N)
+
+    wall=$(echo "${end} ${start}" | awk '{ printf "%.3f", $1 - $2 }')
+    rss=$(sed -n 's/^Verbose: rank 0 peak RSS: \([0-9]*\) KB\.$/\1/p' "${LOG}")
+    bytes=$(sed -n 's/^Verbose: \([0-9]*\) bytes gathered from .*/\1/p' "${LOG}")
+
+    # A budget cannot pass on a metric hpcat did not report
+    if [[ -z "${rss}" && "${MAX_RSS_MB}" != 0 ]] || [[ -z "${bytes}" && "${MAX_BYTES_PER_RANK}" != 0 ]]; then
+        cat "${LOG}" >&2
+        echo "Error: peak RSS or gathered bytes missing from the hpcat output with ${np} ranks" >&2
+        exit 1
+    fi
+
+    echo "${np},${wall},${rss},${bytes}" >> "${CSV}"
+    echo "${np} ranks: ${wall} s, rank 0 peak RSS ${rss:-?} KB, ${bytes:-?} bytes gathered"
+done
+
+# Budgets apply to the largest run
+IFS=, read -r np wall rss bytes < <(tail -n 1 "${CSV}")
+status=0
+
+check_budget()
+{
+    local name=$1 value=$2 budget=$3
+    if awk -v v="${value}" -v b="${budget}" 'BEGIN { exit !(b > 0 && v > b) }'; then
+        echo "FAIL: ${name} ${value} exceeds budget ${budget} (${np} ranks)" >&2
+        status=1
+    fi
+}
+
+check_budget "wall time (s)" "${wall}" "${MAX_SECONDS}"
+check_budget "rank 0 peak RSS (MB)" "$(awk -v r="${rss}" 'BEGIN { printf "%.1f", r / 1024 }')" "${MAX_RSS_MB}"
+check_budget "gathered bytes per rank" "$(( bytes / np ))" "${MAX_BYTES_PER_RANK}"
+
+exit ${status}
@@ -29,6 +29,10 @@
 #define HPCAT_COMMON_H
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
 #include <hwloc.h>
 
 #define FATAL(...)                          \
@@ -47,7 +51,74 @@
         } while(0)
 
 #define PCI_STR_MAX    32
-#define MAX_DEVICES    32
+#define DEVICES_CHUNK  8      /* Initial capacity of device tables */
+#define MAX_DEVICE_ID  4096   /* Upper bound of indexes in visibility lists */
+
+#define SYSFS_ROOT_ENV "HPCAT_SYSFS_ROOT"
+#define MOCK_ACCEL_ENV "HPCAT_MOCK_ACCEL"
+
+/**
+ * Monotonic time, for phase timings and trace events
+ *
+ * @return                   Time in seconds
+ */
+static inline double wtime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Make room for one more element in a growable array (capacity doubled when full).
+ *
+ * @param   array[inout]     Address of the array pointer (NULL when empty)
+ * @param   capacity[inout]  Number of allocated elements
+ * @param   count[in]        Number of elements in use
+ * @param   elem_size[in]    Size of an element
+ * @return                   Success: 0, Error: -1 (array left untouched)
+ */
+static inline int array_grow(void *array, int *capacity, const int count, const size_t elem_size)
+{
+    if (count < *capacity)
+        return 0;
+
+    const int new_capacity = (*capacity == 0) ? DEVICES_CHUNK : *capacity * 2;
+    void *ptr = realloc(*(void **)array, new_capacity * elem_size);
+    if (ptr == NULL)
+        return -1;
+
+    memset((char *)ptr + *capacity * elem_size, 0, (new_capacity - *capacity) * elem_size);
+    *(void **)array = ptr;
+    *capacity = new_capacity;
+
+    return 0;
+}
+
+/**
+ * Format the path of a sysfs or procfs file. The path is prefixed by the
+ * content of HPCAT_SYSFS_ROOT if set, allowing to probe a copy of another system.
+ *
+ * @param   path[out]        Output buffer
+ * @param   max_len[in]      Size of the output buffer
+ * @param   format[in]       Absolute path (printf-like format)
+ * @return                   Length of the formatted path
+ */
+static inline int sysfs_path(char *path, const size_t max_len, const char *format, ...)
+{
+    const char *root = getenv(SYSFS_ROOT_ENV);
+    int len = snprintf(path, max_len, "%s", (root != NULL) ? root : "");
+    if (len < 0 || (size_t)len >= max_len)
+        return len;
+
+    va_list args;
+    va_start(args, format);
+    len += vsnprintf(path + len, max_len - len, format, args);
+    va_end(args);
+
+    return len;
+}
 
 /**
  * Retrieve NUMA affinity of a device based on its PCIe address
@@ -60,7 +131,7 @@ static inline int get_device_numa_affinity(const int domain, const int bus)
 {
     int numa_node = -1;
     char numa_file[PATH_MAX];
-    snprintf(numa_file, PATH_MAX - 1,
+    sysfs_path(numa_file, PATH_MAX - 1,
                     "/sys/class/pci_bus/%04x:%02x/device/numa_node", domain, bus);
 
     FILE* file = fopen(numa_file, "r");
@@ -75,35 +146,77 @@ static inline int get_device_numa_affinity(const int domain, const int bus)
     return numa_node;
 }
 
+/* Resolve a device identifier which is not an index (e.g. UUID) to an index, or -1 */
+typedef int (*device_id_resolver_t)(const char *id);
+
 /**
- * Convert a list (comma separated values) to a bitmap
+ * Convert a list of devices (comma separated values) to a bitmap. Ranges
+ * (0-3) and sub-devices (0.1, the parent device is set) are supported, other
+ * identifiers are converted by the resolver if any. The list is not modified
+ * so it can be the content of an environment variable.
  *
  * @param   bitmap[out]   Preallocated hwloc bitmap
  * @param   list_str[in]  String containing a list of values
+ * @param   resolve[in]   Resolver for non-numeric identifiers (or NULL)
  * @return                Success: 0, Error: -1
  */
-static inline int strlist_to_bitmap(hwloc_bitmap_t bitmap, char *list_str)
+static inline int strlist_to_bitmap_resolve(hwloc_bitmap_t bitmap, const char *list_str,
+                                            device_id_resolver_t resolve)
 {
-    char *token = strtok(list_str, ",");
+    char *list = strdup(list_str), *saveptr = NULL;
+    if (list == NULL)
+        return -1;
 
-    while (token != NULL)
+    int ret = 0;
+    for (char *token = strtok_r(list, ",", &saveptr); token != NULL;
+         token = strtok_r(NULL, ",", &saveptr))
     {
         char *endptr;
-
-        long val = strtol(token, &endptr, 10);
-
-        if (*endptr != '\0')
-            return -1;
-
-        if (val > MAX_DEVICES)
-            return -1;
-
-        hwloc_bitmap_set(bitmap, val);
-
-        token = strtok(NULL, ",");
+        long first = strtol(token, &endptr, 10), last = first;
+
+        if (endptr == token)
+        {
+            first = last = (resolve != NULL) ? resolve(token) : -1;
+            endptr = "";
+        }
+        else if (*endptr == '-')
+        {
+            char *range = endptr + 1;
+            last = strtol(range, &endptr, 10);
+            if (endptr == range)
+                last = -1;
+        }
+        else if (*endptr == '.')
+        {
+            char *sub_device = endptr + 1;
+            strtol(sub_device, &endptr, 10);
+            if (endptr == sub_device)
+                last = -1;
+        }
+
+        if ((*endptr != '\0') || (first < 0) || (last < first) || (last >= MAX_DEVICE_ID))
+        {
+            ret = -1;
+            break;
+        }
+
+        hwloc_bitmap_set_range(bitmap, first, last);
     }
 
-    return 0;
+    free(list);
+    return ret;
+}
+
+/**
+ * Convert a list (comma separated values) to a bitmap
+ *
+ * @param   bitmap[out]   Preallocated hwloc bitmap
+ * @param   list_str[in]  String containing a list of values
+ * @return                Success: 0, Error: -1
+ */
+static inline int strlist_to_bitmap(hwloc_bitmap_t bitmap, const char *list_str)
+{
+    return strlist_to_bitmap_resolve(bitmap, list_str, NULL);
 }
 
 /**
@@ -0,0 +1,342 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* diff.c: Compare two saved runs to detect binding drift (--diff).
+*
+* Ranks are aligned by node (in order of appearance) and by local rank, so runs
+* on different nodes can be compared. Each category of a rank record (cpuset,
+* cores, NUMA, threads, accelerators, NIC, fabric group, hints) is reduced to a
+* hash, aligned ranks only compare hashes and values are formatted for the first
+* change of each category. Comparison is linear in the number of ranks.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diff.h"
+#include "hint.h"
+#include "outbuf.h"
+#include "common.h"
+
+#define FNV_OFFSET  0xcbf29ce484222325ULL
+#define FNV_PRIME   0x100000001b3ULL
+
+typedef enum DiffCategory
+{
+    DIFF_CPUSET = 0,
+    DIFF_CORES,
+    DIFF_NUMA,
+    DIFF_OMP,
+    DIFF_ACCEL,
+    DIFF_NIC,
+    DIFF_FABRIC,
+    DIFF_HINTS,
+    DIFF_MAX
+} DiffCategory_t;
+
+static const char *const category_str[DIFF_MAX] =
+{
+    [DIFF_CPUSET] = "cpuset",
+    [DIFF_CORES]  = "cores",
+    [DIFF_NUMA]   = "numa",
+    [DIFF_OMP]    = "omp",
+    [DIFF_ACCEL]  = "accelerators",
+    [DIFF_NIC]    = "nic",
+    [DIFF_FABRIC] = "fabric_group",
+    [DIFF_HINTS]  = "hints",
+};
+
+/* Ranks with a change in a category, the first one is displayed in detail */
+typedef struct
+{
+    int *ranks;
+    int count;
+    int capacity;
+    int first[2];     /* Rank in each run */
+} DiffList;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, const size_t size)
+{
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+
+    return hash;
+}
+
+/* Trailing empty words depend on the machine, only the set bits are hashed */
+static uint64_t hash_bitmap(uint64_t hash, const Bitmap *bitmap)
+{
+    int num_ulongs = bitmap->num_ulongs;
+    while ((num_ulongs > 0) && (bitmap->ulongs[num_ulongs - 1] == 0))
+        num_ulongs--;
+
+    hash = hash_bytes(hash, &num_ulongs, sizeof(int));
+    return hash_bytes(hash, bitmap->ulongs, num_ulongs * sizeof(unsigned long));
+}
+
+/* Hash a string of a char array (max_len: size of the array), terminator included */
+static uint64_t hash_str(uint64_t hash, const char *str, const size_t max_len)
+{
+    hash = hash_bytes(hash, str, strnlen(str, max_len));
+    return hash_bytes(hash, "", 1);
+}
+
+static void task_hashes(const Task *task, uint64_t hashes[DIFF_MAX])
+{
+    for (int i = 0; i < DIFF_MAX; i++)
+        hashes[i] = FNV_OFFSET;
+
+    hashes[DIFF_CPUSET] = hash_bitmap(hashes[DIFF_CPUSET], &task->affinity.hw_thread_affinity);
+    hashes[DIFF_CORES] = hash_bitmap(hashes[DIFF_CORES], &task->affinity.core_affinity);
+    hashes[DIFF_NUMA] = hash_bitmap(hashes[DIFF_NUMA], &task->affinity.numa_affinity);
+
+    hashes[DIFF_OMP] = hash_bytes(hashes[DIFF_OMP], &task->num_threads, sizeof(int));
+    for (int i = 0; i < task->num_threads; i++)
+        hashes[DIFF_OMP] = hash_bitmap(hashes[DIFF_OMP], &task->threads[i].affinity.hw_thread_affinity);
+
+    hashes[DIFF_ACCEL] = hash_str(hashes[DIFF_ACCEL], task->accel.pciaddr, sizeof(task->accel.pciaddr));
+    hashes[DIFF_ACCEL] = hash_str(hashes[DIFF_ACCEL], task->accel.partition, sizeof(task->accel.partition));
+    hashes[DIFF_ACCEL] = hash_bitmap(hashes[DIFF_ACCEL], &task->accel.visible_devices);
+
+    hashes[DIFF_NIC] = hash_str(hashes[DIFF_NIC], task->nic.name, sizeof(task->nic.name));
+    hashes[DIFF_FABRIC] = hash_bytes(hashes[DIFF_FABRIC], &task->fabric_group_id, sizeof(int));
+    hashes[DIFF_HINTS] = hash_bytes(hashes[DIFF_HINTS], &task->detected_hints, sizeof(char));
+}
+
+static void bitmap_str(char *str, const Bitmap *bitmap, hwloc_bitmap_t tmp)
+{
+    hwloc_bitmap_zero(tmp);
+    hwloc_bitmap_from_ulongs(tmp, bitmap->num_ulongs, bitmap->ulongs);
+    hwloc_bitmap_list_snprintf(str, STR_MAX - 1, tmp);
+}
+
+/* Value of a category for the detail of the first change */
+static void category_value(char *str, const Task *task, const DiffCategory_t category, hwloc_bitmap_t tmp)
+{
+    char bitmap[STR_MAX];
+    int len = 0;
+
+    str[0] = '\0';
+
+    switch (category)
+    {
+        case DIFF_CPUSET:
+            bitmap_str(str, &task->affinity.hw_thread_affinity, tmp);
+            break;
+        case DIFF_CORES:
+            bitmap_str(str, &task->affinity.core_affinity, tmp);
+            break;
+        case DIFF_NUMA:
+            bitmap_str(str, &task->affinity.numa_affinity, tmp);
+            break;
+        case DIFF_OMP:
+            for (int i = 0; (i < task->num_threads) && (len < STR_MAX - 1); i++)
+            {
+                bitmap_str(bitmap, &task->threads[i].affinity.hw_thread_affinity, tmp);
+                len += snprintf(str + len, STR_MAX - len, "%s%d:%s", (i == 0) ? "" : " ",
+                                task->threads[i].id, bitmap);
+            }
+            break;
+        case DIFF_ACCEL:
+            bitmap_str(bitmap, &task->accel.visible_devices, tmp);
+            len = snprintf(str, STR_MAX, "%s", (task->accel.num_accel > 0) ? task->accel.pciaddr : "none");
+            if (len < STR_MAX - 1)
+                len += snprintf(str + len, STR_MAX - len, " (visible %s)%s%s", (bitmap[0] != '\0') ? bitmap : "none",
+                                (task->accel.partition[0] != '\0') ? " " : "", task->accel.partition);
+            break;
+        case DIFF_NIC:
+            snprintf(str, STR_MAX, "%s", (task->nic.name[0] != '\0') ? task->nic.name : "none");
+            break;
+        case DIFF_FABRIC:
+            snprintf(str, STR_MAX, "%d", task->fabric_group_id);
+            break;
+        case DIFF_HINTS:
+            for (int i = 0; (i < HINT_MAX) && (len < STR_MAX - 1); i++)
+                if (hpcat_hint_is_set(task->detected_hints, i))
+                    len += snprintf(str + len, STR_MAX - len, "%s%s", (len == 0) ? "" : ",", hpcat_hint_code(i));
+            break;
+        default:
+            break;
+    }
+
+    if (str[0] == '\0')
+        snprintf(str, STR_MAX, "none");
+}
+
+static void list_add(DiffList *list, const int rank_a, const int rank_b)
+{
+    if (array_grow(&list->ranks, &list->capacity, list->count, sizeof(int)) != 0)
+        FATAL("Error: unable to allocate diff buffer. Exiting.\n");
+
+    if (list->count == 0)
+    {
+        list->first[0] = rank_a;
+        list->first[1] = rank_b;
+    }
+
+    list->ranks[list->count++] = (rank_a >= 0) ? rank_a : rank_b;
+}
+
+/* Number of ranks and compressed list of ranks */
+static void write_ranks(OutBuffer *out, DiffList *list)
+{
+    hpcat_out_printf(out, "%d rank%s: ", list->count, (list->count > 1) ? "s" : "");
+    hpcat_out_ranks(out, list->ranks, list->count);
+    hpcat_out_write(out, "\n", 1);
+}
+
+/* Number of ranks of the node starting at a position of the node order, 0 past the end */
+static int node_size(const Hpcat *run, const Task *tasks, const int *reordered_ranks, const int pos)
+{
+    int size = 0;
+
+    if (pos >= run->num_tasks)
+        return 0;
+
+    do
+        size++;
+    while ((pos + size < run->num_tasks) && !tasks[reordered_ranks[pos + size]].is_first_node_rank);
+
+    return size;
+}
+
+/**
+ * Compare two saved runs and write the changes by category in the output buffer.
+ * Runs are resolved (node mapping and hints) by the caller.
+ *
+ * @param   hpcat[inout]            Application handle (output buffer and file names)
+ * @param   runs[in]                Handle of each run
+ * @param   tasks[in]               Task records of each run, indexed by rank
+ * @param   reordered_ranks[in]     Ranks of each run in node order
+ * @return                          Number of differences (changed and unmatched ranks)
+ */
+int hpcat_diff(Hpcat *hpcat, Hpcat runs[2], Task *tasks[2], int *reordered_ranks[2])
+{
+    OutBuffer *out = &hpcat->out;
+    DiffList lists[DIFF_MAX] = { 0 }, unmatched[2] = { 0 };
+    int pos[2] = { 0, 0 }, num_aligned = 0, num_changed = 0;
+    uint64_t hashes[2][DIFF_MAX];
+
+    /* Align the ranks of each node, nodes in order of appearance */
+    while ((pos[0] < runs[0].num_tasks) || (pos[1] < runs[1].num_tasks))
+    {
+        const int size[2] = { node_size(&runs[0], tasks[0], reordered_ranks[0], pos[0]),
+                              node_size(&runs[1], tasks[1], reordered_ranks[1], pos[1]) };
+
+        for (int i = 0; i < size[0] || i < size[1]; i++)
+        {
+            const int rank_a = (i < size[0]) ? reordered_ranks[0][pos[0] + i] : -1;
+            const int rank_b = (i < size[1]) ? reordered_ranks[1][pos[1] + i] : -1;
+
+            if ((rank_a < 0) || (rank_b < 0))
+            {
+                list_add(&unmatched[(rank_a < 0) ? 1 : 0], rank_a, rank_b);
+                continue;
+            }
+
+            num_aligned++;
+            task_hashes(&tasks[0][rank_a], hashes[0]);
+            task_hashes(&tasks[1][rank_b], hashes[1]);
+
+            bool is_changed = false;
+            for (int c = 0; c < DIFF_MAX; c++)
+            {
+                if (hashes[0][c] != hashes[1][c])
+                {
+                    list_add(&lists[c], rank_a, rank_b);
+                    is_changed = true;
+                }
+            }
+
+            if (is_changed)
+                num_changed++;
+        }
+
+        pos[0] += size[0];
+        pos[1] += size[1];
+    }
+
+    for (int i = 0; i < 2; i++)
+        hpcat_out_printf(out, "%c: %s (%d ranks, %d nodes)\n", 'A' + i, hpcat->settings.diff_files[i],
+                         runs[i].num_tasks, runs[i].num_nodes);
+
+    int num_diffs = num_changed + unmatched[0].count + unmatched[1].count;
+    if (strcmp(runs[0].mpi_version, runs[1].mpi_version) != 0)
+    {
+        hpcat_out_printf(out, "%-14s changed\n    A: %s\n    B: %s\n", "mpi_version",
+                         runs[0].mpi_version, runs[1].mpi_version);
+        num_diffs++;
+    }
+
+    hwloc_bitmap_t tmp = hwloc_bitmap_alloc();
+    if (tmp == NULL)
+        FATAL("Error: unable to allocate a hwloc bitmap. Exiting.\n");
+
+    for (int c = 0; c < DIFF_MAX; c++)
+    {
+        char value[2][STR_MAX];
+        DiffList *list = &lists[c];
+
+        if (list->count == 0)
+            continue;
+
+        hpcat_out_printf(out, "%-14s ", category_str[c]);
+        write_ranks(out, list);
+
+        for (int i = 0; i < 2; i++)
+            category_value(value[i], &tasks[i][list->first[i]], c, tmp);
+
+        if (list->first[0] == list->first[1])
+            hpcat_out_printf(out, "    rank %d: %s -> %s\n", list->first[0], value[0], value[1]);
+        else
+            hpcat_out_printf(out, "    rank %d (B: %d): %s -> %s\n", list->first[0], list->first[1],
+                             value[0], value[1]);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (unmatched[i].count == 0)
+            continue;
+
+        hpcat_out_printf(out, "only in %c      ", 'A' + i);
+        write_ranks(out, &unmatched[i]);
+    }
+
+    if (num_diffs == 0)
+        hpcat_out_printf(out, "No differences.\n");
+    else
+        hpcat_out_printf(out, "%d of %d aligned ranks changed.\n", num_changed, num_aligned);
+
+    hwloc_bitmap_free(tmp);
+    for (int c = 0; c < DIFF_MAX; c++)
+        free(lists[c].ranks);
+    free(unmatched[0].ranks);
+    free(unmatched[1].ranks);
+
+    return num_diffs;
+}
@@ -0,0 +1,226 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* dump.c: Save the gathered task records of a run and load them back (--save,
+*         --replay).
+*
+* The file starts with a versioned header holding the settings of the collection
+* and the MPI library version, followed by the packed record of each rank (see
+* hpcat_task_pack) prefixed by its size. Records are raw structures in the byte
+* order of the writer, the header keeps the version of their layout and their
+* sizes to reject files written by another release or a build with different
+* limits.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+#include "task.h"
+#include "common.h"
+
+#define DUMP_MAGIC      "HPCATDMP"
+#define DUMP_MAGIC_LEN  8
+#define DUMP_VERSION    2
+
+/* Settings of the collection, the replay renders the records with them */
+#define DUMP_FLAG_NIC          0x1
+#define DUMP_FLAG_FABRIC       0x2
+#define DUMP_FLAG_OMP          0x4
+#define DUMP_FLAG_IO_LOCALITY  0x8
+
+typedef struct
+{
+    char     magic[DUMP_MAGIC_LEN];
+    uint32_t version;
+    uint32_t pack_version;      /* TASK_PACK_VERSION of the writer */
+    uint32_t task_size;         /* sizeof(Task) of the writer */
+    uint32_t thread_size;       /* sizeof(Thread) of the writer */
+    uint32_t flags;             /* DUMP_FLAG_* */
+    int32_t  num_tasks;
+    uint32_t mpi_version_len;   /* Followed by the MPI library version (not terminated) */
+} DumpHeader;
+
+/**
+ * Write the task records gathered on rank 0 and the settings of the run in a file
+ *
+ * @param   hpcat[in]        Application handle
+ * @param   collection[in]   Settings of the collection, before the node mapping
+ *                           disables NIC and fabric on a single node (the replay
+ *                           checks hints and maps nodes again)
+ * @param   tasks[in]        Task records, indexed by rank
+ */
+void hpcat_dump_save(const Hpcat *hpcat, const HpcatSettings_t *collection, const Task *tasks)
+{
+    FILE *file = fopen(hpcat->settings.save_file, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Warning: unable to save the records in %s.\n", hpcat->settings.save_file);
+        return;
+    }
+
+    DumpHeader header = { 0 };
+    memcpy(header.magic, DUMP_MAGIC, DUMP_MAGIC_LEN);
+    header.version = DUMP_VERSION;
+    header.pack_version = TASK_PACK_VERSION;
+    header.task_size = sizeof(Task);
+    header.thread_size = sizeof(Thread);
+    header.num_tasks = hpcat->num_tasks;
+    header.mpi_version_len = strnlen(hpcat->mpi_version, MPI_MAX_LIBRARY_VERSION_STRING - 1);
+
+    if (collection->enable_nic)
+        header.flags |= DUMP_FLAG_NIC;
+    if (collection->enable_fabric)
+        header.flags |= DUMP_FLAG_FABRIC;
+    if (collection->enable_omp)
+        header.flags |= DUMP_FLAG_OMP;
+    if (collection->enable_io_locality)
+        header.flags |= DUMP_FLAG_IO_LOCALITY;
+
+    bool is_ok = (fwrite(&header, sizeof(DumpHeader), 1, file) == 1) &&
+                 (fwrite(hpcat->mpi_version, 1, header.mpi_version_len, file) == header.mpi_version_len);
+
+    /* Records are packed one at a time, the largest buffer is reused */
+    char *buffer = NULL;
+    size_t capacity = 0, total = sizeof(DumpHeader) + header.mpi_version_len;
+
+    for (int i = 0; (i < hpcat->num_tasks) && is_ok; i++)
+    {
+        const uint64_t size = hpcat_task_pack_size(&tasks[i]);
+        if (size > capacity)
+        {
+            free(buffer);
+            capacity = size;
+            buffer = malloc(capacity);
+            if (buffer == NULL)
+                FATAL("Error: unable to allocate task record. Exiting.\n");
+        }
+
+        hpcat_task_pack(&tasks[i], buffer);
+        is_ok = (fwrite(&size, sizeof(uint64_t), 1, file) == 1) &&
+                (fwrite(buffer, 1, size, file) == size);
+        total += sizeof(uint64_t) + size;
+    }
+
+    free(buffer);
+
+    if ((fclose(file) != 0) || !is_ok)
+        fprintf(stderr, "Warning: unable to save the records in %s.\n", hpcat->settings.save_file);
+    else
+        VERBOSE(hpcat, "Verbose: %zu bytes saved in %s.\n", total, hpcat->settings.save_file);
+}
+
+static void read_or_fail(void *dest, const size_t size, FILE *file, const char *filename)
+{
+    if (fread(dest, 1, size, file) != size)
+        FATAL("Error: %s is truncated. Exiting.\n", filename);
+}
+
+/**
+ * Load the task records and the settings of a saved run (--replay). The number of
+ * tasks, the MPI library version and the collection settings of the handle are
+ * replaced by the saved ones.
+ *
+ * @param   hpcat[inout]   Application handle
+ * @param   filename[in]   File written by hpcat_dump_save()
+ * @return                 Task records indexed by rank, release with hpcat_task_free()
+ */
+Task *hpcat_dump_load(Hpcat *hpcat, const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+        FATAL("Error: unable to open %s. Exiting.\n", filename);
+
+    DumpHeader header;
+    read_or_fail(&header, sizeof(DumpHeader), file, filename);
+
+    if (memcmp(header.magic, DUMP_MAGIC, DUMP_MAGIC_LEN) != 0)
+        FATAL("Error: %s is not a file saved by hpcat. Exiting.\n", filename);
+
+    if (header.version != DUMP_VERSION)
+        FATAL("Error: %s has format version %u, this build reads version %d. Exiting.\n",
+              filename, header.version, DUMP_VERSION);
+
+    if (header.pack_version != TASK_PACK_VERSION)
+        FATAL("Error: %s has task records version %u, this build reads version %d. Exiting.\n",
+              filename, header.pack_version, TASK_PACK_VERSION);
+
+    if ((header.task_size != sizeof(Task)) || (header.thread_size != sizeof(Thread)))
+        FATAL("Error: %s was saved by a build with different limits. Exiting.\n", filename);
+
+    if (header.num_tasks <= 0)
+        FATAL("Error: %s holds no task records. Exiting.\n", filename);
+
+    if (header.mpi_version_len >= MPI_MAX_LIBRARY_VERSION_STRING)
+        FATAL("Error: %s has an MPI library version longer than this build supports. Exiting.\n",
+              filename);
+
+    read_or_fail(hpcat->mpi_version, header.mpi_version_len, file, filename);
+    hpcat->mpi_version[header.mpi_version_len] = '\0';
+
+    hpcat->num_tasks = header.num_tasks;
+    hpcat->settings.enable_nic = (header.flags & DUMP_FLAG_NIC) != 0;
+    hpcat->settings.enable_fabric = (header.flags & DUMP_FLAG_FABRIC) != 0;
+    hpcat->settings.enable_omp = (header.flags & DUMP_FLAG_OMP) != 0;
+    hpcat->settings.enable_io_locality = (header.flags & DUMP_FLAG_IO_LOCALITY) != 0;
+
+    Task *tasks = calloc(hpcat->num_tasks, sizeof(Task));
+    if (tasks == NULL)
+        FATAL("Error: unable to allocate tasks buffer. Exiting.\n");
+
+    char *buffer = NULL;
+    size_t capacity = 0;
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        uint64_t size;
+        read_or_fail(&size, sizeof(uint64_t), file, filename);
+
+        if (size > capacity)
+        {
+            free(buffer);
+            capacity = size;
+            buffer = malloc(capacity);
+            if (buffer == NULL)
+                FATAL("Error: unable to allocate task record. Exiting.\n");
+        }
+
+        read_or_fail(buffer, size, file, filename);
+
+        /* Bitmaps and threads are sized from the record itself, check it before unpacking */
+        if (hpcat_task_packed_size(buffer, size) != size)
+            FATAL("Error: %s has an invalid record (rank %d). Exiting.\n", filename, i);
+
+        hpcat_task_unpack(&tasks[i], buffer);
+    }
+
+    free(buffer);
+    fclose(file);
+
+    VERBOSE(hpcat, "Verbose: %d task records loaded from %s.\n", hpcat->num_tasks, filename);
+
+    return tasks;
+}
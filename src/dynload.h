@@ -0,0 +1,60 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* dynload.h: Vendor runtime calls from accelerator modules.
+*
+* Dynamic modules are linked against their vendor runtime. When a module is
+* built in the hpcat binary (HPCAT_STATIC_BACKEND), the binary must not
+* depend on it: runtime functions are then called through pointers resolved
+* with dlsym on the handle of the vendor library loaded by hpcat.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#ifndef HPCAT_DYNLOAD_H
+#define HPCAT_DYNLOAD_H
+
+#ifdef HPCAT_STATIC_BACKEND
+
+#include <dlfcn.h>
+
+/* Runtime headers may map functions to versioned symbols (e.g. nvmlInit_v2) */
+#define DYNLOAD_STR_(sym)  #sym
+#define DYNLOAD_STR(sym)   DYNLOAD_STR_(sym)
+
+#define DYNLOAD_DECLARE(sym)  static __typeof__(&sym) dynload_##sym = NULL;
+
+/* Resolve a symbol from lib_handle, return -1 from the calling function if missing */
+#define DYNLOAD_RESOLVE(sym)                                                              \
+        if ((dynload_##sym = (__typeof__(&sym))dlsym(lib_handle, DYNLOAD_STR(sym))) == NULL) \
+            return -1;
+
+#define DYNCALL(sym)  (*dynload_##sym)
+
+#else
+
+#define DYNLOAD_DECLARE(sym)
+#define DYNCALL(sym)  sym
+
+#endif /* HPCAT_STATIC_BACKEND */
+
+#endif /* HPCAT_DYNLOAD_H */
@@ -0,0 +1,255 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* expect.c: Validation of the placement against expected rules (--expect).
+*
+* A specification is a comma separated list of rules:
+*   gpus=N                    exactly N visible GPUs per rank
+*   max_numa=N                at most N NUMA nodes per rank
+*   max_threads_per_core=N    at most N hardware threads per core of a rank
+*   no_<hint>                 hint not reported for any rank (JSON hint identifiers,
+*                             e.g. no_shared_cores), no_hints for all of them
+* Rules are checked on the task records after the hints, violations are summarized
+* on the error output and the exit code is non-zero.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "expect.h"
+#include "hint.h"
+#include "outbuf.h"
+#include "common.h"
+
+#define NO_HINT_PREFIX "no_"
+
+static const char *const expect_str[] =
+{
+    [EXPECT_GPUS]                 = "gpus",
+    [EXPECT_MAX_NUMA]             = "max_numa",
+    [EXPECT_MAX_THREADS_PER_CORE] = "max_threads_per_core",
+};
+
+static int parse_rule(Expectation *rule, const char *token)
+{
+    const size_t prefix_len = strlen(NO_HINT_PREFIX);
+
+    if (strncmp(token, NO_HINT_PREFIX, prefix_len) == 0)
+    {
+        rule->type = EXPECT_NO_HINT;
+
+        if (strcmp(token + prefix_len, "hints") == 0)
+        {
+            rule->value = HINT_MAX;
+            return 0;
+        }
+
+        for (int i = 0; i < HINT_MAX; i++)
+        {
+            if (strcmp(token + prefix_len, hpcat_hint_code(i)) == 0)
+            {
+                rule->value = i;
+                return 0;
+            }
+        }
+
+        return -1;
+    }
+
+    for (int i = EXPECT_GPUS; i < EXPECT_NO_HINT; i++)
+    {
+        const size_t len = strlen(expect_str[i]);
+        if ((strncmp(token, expect_str[i], len) != 0) || (token[len] != '='))
+            continue;
+
+        char *endptr;
+        const long value = strtol(token + len + 1, &endptr, 10);
+        if ((endptr == token + len + 1) || (*endptr != '\0') || (value < 0) || (value > MAX_DEVICE_ID))
+            return -1;
+
+        rule->type = i;
+        rule->value = (int)value;
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Parse the rules of a specification (before MPI initialization, so a wrong
+ * specification does not cost a job)
+ *
+ * @param   hpcat[inout]   Application handle
+ * @param   spec[in]       Comma separated list of rules
+ */
+void hpcat_expect_parse(Hpcat *hpcat, const char *spec)
+{
+    char *list = strdup(spec), *saveptr = NULL;
+    if (list == NULL)
+        FATAL("Error: unable to allocate expectations. Exiting.\n");
+
+    for (char *token = strtok_r(list, ",", &saveptr); token != NULL;
+         token = strtok_r(NULL, ",", &saveptr))
+    {
+        if (hpcat->num_expectations == EXPECTATIONS_MAX)
+            FATAL("Error: more than %d rules in --expect. Exiting.\n", EXPECTATIONS_MAX);
+
+        Expectation *rule = &hpcat->expectations[hpcat->num_expectations];
+        if (parse_rule(rule, token) != 0)
+            FATAL("Error: invalid rule '%s' in --expect. Exiting.\n", token);
+
+        if ((rule->type == EXPECT_NO_HINT) && !hpcat->settings.enable_hints)
+            FATAL("Error: rule '%s' of --expect requires hints. Exiting.\n", token);
+
+        hpcat->num_expectations++;
+    }
+
+    free(list);
+
+    if (hpcat->num_expectations == 0)
+        FATAL("Error: no rule in --expect. Exiting.\n");
+}
+
+static int bitmap_weight(const Bitmap *bitmap, hwloc_bitmap_t tmp)
+{
+    hwloc_bitmap_zero(tmp);
+    hwloc_bitmap_from_ulongs(tmp, bitmap->num_ulongs, bitmap->ulongs);
+
+    return hwloc_bitmap_weight(tmp);
+}
+
+/* Value of a rule for a task (limit rules) or whether the task complies (hint rules) */
+static int rule_value(const Expectation *rule, const Task *task, hwloc_bitmap_t tmp)
+{
+    switch (rule->type)
+    {
+        case EXPECT_GPUS:
+            return task->accel.num_accel;
+        case EXPECT_MAX_NUMA:
+            return bitmap_weight(&task->affinity.numa_affinity, tmp);
+        case EXPECT_MAX_THREADS_PER_CORE:
+        {
+            const int num_cores = bitmap_weight(&task->affinity.core_affinity, tmp);
+            const int num_threads = bitmap_weight(&task->affinity.hw_thread_affinity, tmp);
+
+            /* Rounded up, a single core with two threads is not compliant with 1 */
+            return (num_cores > 0) ? (num_threads + num_cores - 1) / num_cores : 0;
+        }
+        case EXPECT_NO_HINT:
+            if (rule->value == HINT_MAX)
+                return !hint_is_empty(task->detected_hints);
+            return hpcat_hint_is_set(task->detected_hints, rule->value);
+        default:
+            return 0;
+    }
+}
+
+static bool rule_is_met(const Expectation *rule, const int value)
+{
+    switch (rule->type)
+    {
+        case EXPECT_GPUS:
+            return (value == rule->value);
+        case EXPECT_MAX_NUMA:
+        case EXPECT_MAX_THREADS_PER_CORE:
+            return (value <= rule->value);
+        default:
+            return (value == 0);
+    }
+}
+
+static void write_rule(OutBuffer *out, const Expectation *rule)
+{
+    if (rule->type != EXPECT_NO_HINT)
+        hpcat_out_printf(out, "%s=%d", expect_str[rule->type], rule->value);
+    else
+        hpcat_out_printf(out, NO_HINT_PREFIX "%s", (rule->value == HINT_MAX) ? "hints" : hpcat_hint_code(rule->value));
+}
+
+/**
+ * Check the rules on the task records of all ranks (rank 0, after the render which
+ * resolves the cross-task hints) and summarize the violations on the error output
+ *
+ * @param   hpcat[in]      Application handle
+ * @param   tasks[in]      Task records, indexed by rank
+ * @return                 Number of rules not met
+ */
+int hpcat_expect_check(Hpcat *hpcat, const Task *tasks)
+{
+    int *ranks = malloc(hpcat->num_tasks * sizeof(int));
+    hwloc_bitmap_t tmp = hwloc_bitmap_alloc();
+    if ((ranks == NULL) || (tmp == NULL))
+        FATAL("Error: unable to allocate expectation buffers. Exiting.\n");
+
+    OutBuffer out;
+    hpcat_out_init(&out, STDERR_FILENO);
+
+    int num_failed = 0;
+    for (int i = 0; i < hpcat->num_expectations; i++)
+    {
+        const Expectation *rule = &hpcat->expectations[i];
+        int count = 0, first_value = 0;
+
+        for (int j = 0; j < hpcat->num_tasks; j++)
+        {
+            const int value = rule_value(rule, &tasks[j], tmp);
+            if (rule_is_met(rule, value))
+                continue;
+
+            if (count == 0)
+                first_value = value;
+            ranks[count++] = j;
+        }
+
+        if (count == 0)
+            continue;
+
+        num_failed++;
+        const int first_rank = ranks[0];
+
+        hpcat_out_printf(&out, "Expectation ");
+        write_rule(&out, rule);
+        hpcat_out_printf(&out, " not met by %d rank%s: ", count, (count > 1) ? "s" : "");
+        hpcat_out_ranks(&out, ranks, count);
+
+        if (rule->type != EXPECT_NO_HINT)
+            hpcat_out_printf(&out, " (rank %d: %d)", first_rank, first_value);
+        hpcat_out_write(&out, "\n", 1);
+    }
+
+    if (num_failed > 0)
+        hpcat_out_printf(&out, "%d of %d expectations not met.\n", num_failed, hpcat->num_expectations);
+
+    hpcat_out_flush(&out);
+    hpcat_out_free(&out);
+    hwloc_bitmap_free(tmp);
+    free(ranks);
+
+    if (num_failed == 0)
+        VERBOSE(hpcat, "Verbose: %d expectations met by %d ranks.\n", hpcat->num_expectations, hpcat->num_tasks);
+
+    return num_failed;
+}
@@ -38,6 +38,8 @@ static const char * const hint_str[] =
     [HINT_DIFFERENT_CPU_GPU_NUMA]   = "Task(s) have different CPU and GPU NUMA affinities",
     [HINT_DIFFERENT_CPU_NIC_NUMA]   = "Task(s) have different CPU and NIC NUMA affinities",
     [HINT_DIFFERENT_GPU_NIC_NUMA]   = "Task(s) have different GPU and NIC NUMA affinities",
+    [HINT_DISTANT_CPU_GPU]          = "Task(s) use CPU cores not closest to their GPU (L3/CCD)",
+    [HINT_CLOSER_NIC]               = "Task(s) use a NIC while another one is closer to their GPU (PCIe)",
 };
 
 static const char *const hint_superscript[] =
@@ -47,8 +49,21 @@ static const char *const hint_superscript[] =
     [HINT_DIFFERENT_CPU_GPU_NUMA]   = "c)",
     [HINT_DIFFERENT_CPU_NIC_NUMA]   = "d)",
     [HINT_DIFFERENT_GPU_NIC_NUMA]   = "e)",
+    [HINT_DISTANT_CPU_GPU]          = "f)",
+    [HINT_CLOSER_NIC]               = "g)",
 };
 
+/* Stable identifiers of hints (JSON output) */
+static const char *const hint_code[] =
+{
+    [HINT_SHARED_CORES]             = "shared_cores",
+    [HINT_MULTIPLE_NUMA_NODES]      = "multiple_numa_nodes",
+    [HINT_DIFFERENT_CPU_GPU_NUMA]   = "different_cpu_gpu_numa",
+    [HINT_DIFFERENT_CPU_NIC_NUMA]   = "different_cpu_nic_numa",
+    [HINT_DIFFERENT_GPU_NIC_NUMA]   = "different_gpu_nic_numa",
+    [HINT_DISTANT_CPU_GPU]          = "distant_cpu_gpu",
+    [HINT_CLOSER_NIC]               = "closer_nic",
+};
 
 static inline void hint_set(char *detected_hints, const HintType_t type)
 {
@@ -115,6 +130,38 @@ void hpcat_hint_global_check(Hpcat *hpcat, Task *task)
     hpcat->detected_hints |= task->detected_hints;
 }
 
+/**
+ * Parallel variant of the cross-task check, used when records are not gathered. The
+ * cores of the previous ranks of the node are obtained by the caller with a prefix
+ * reduction instead of a walk over all tasks.
+ *
+ * @param   hpcat[in]         Global context
+ * @param   task[in,out]      Task context
+ * @param   prev_ulongs[in]   Cores of the previous ranks of the node, NULL on its first rank
+ * @param   num_ulongs[in]    Size of prev_ulongs
+ */
+void hpcat_hint_node_check(Hpcat *hpcat, Task *task, const unsigned long *prev_ulongs,
+                           const int num_ulongs)
+{
+    if (!hpcat->settings.enable_hints || (prev_ulongs == NULL))
+        return;
+
+    Bitmap *cores = &task->affinity.core_affinity;
+    hwloc_bitmap_t task_cpu_bitmap = alloc_bitmap();
+    hwloc_bitmap_t prev_cpu_bitmap = alloc_bitmap();
+
+    /* Same rule as hpcat_hint_global_check() */
+    hwloc_bitmap_from_ulongs(task_cpu_bitmap, cores->num_ulongs, cores->ulongs);
+    hwloc_bitmap_from_ulongs(prev_cpu_bitmap, num_ulongs, prev_ulongs);
+    hwloc_bitmap_and(prev_cpu_bitmap, prev_cpu_bitmap, task_cpu_bitmap);
+
+    if (hwloc_bitmap_weight(prev_cpu_bitmap) > 1)
+        hint_set(&task->detected_hints, HINT_SHARED_CORES);
+
+    hwloc_bitmap_free(task_cpu_bitmap);
+    hwloc_bitmap_free(prev_cpu_bitmap);
+}
+
 /**
  * Analyzes a single task and updates its detected_hints field.
  *
@@ -142,7 +189,9 @@ void hpcat_hint_task_check(Hpcat *hpcat, Task *task)
     if (hpcat->settings.enable_nic)
     {
         hwloc_bitmap_zero(tmp_bitmap);
-        hwloc_bitmap_set(nic_numa_bitmap, task->nic.numa_affinity);
+        hwloc_bitmap_from_ulongs(nic_numa_bitmap,
+                                 task->nic.numa_affinity.num_ulongs,
+                                 task->nic.numa_affinity.ulongs);
         hwloc_bitmap_xor(tmp_bitmap, nic_numa_bitmap, cpu_numa_bitmap);
 
         if (hwloc_bitmap_weight(tmp_bitmap) > 1)
@@ -173,6 +222,28 @@ void hpcat_hint_task_check(Hpcat *hpcat, Task *task)
             hint_set(&task->detected_hints, HINT_DIFFERENT_GPU_NIC_NUMA);
     }
 
+    /* GPU-NIC PCIe path (GPUDirect RDMA) */
+    if (hpcat->settings.enable_nic && hpcat->settings.enable_accel && task->nic.has_closer_nic)
+        hint_set(&task->detected_hints, HINT_CLOSER_NIC);
+
+    /* CPU-GPU locality mismatch within a NUMA node (I/O locality only) */
+    if (hpcat->settings.enable_accel && (task->accel.locality.cores.num_ulongs > 0) &&
+        !hint_is_set(task->detected_hints, HINT_DIFFERENT_CPU_GPU_NUMA))
+    {
+        hwloc_bitmap_t cpu_core_bitmap = alloc_bitmap();
+        hwloc_bitmap_from_ulongs(cpu_core_bitmap,
+                                 task->affinity.core_affinity.num_ulongs,
+                                 task->affinity.core_affinity.ulongs);
+        hwloc_bitmap_from_ulongs(tmp_bitmap,
+                                 task->accel.locality.cores.num_ulongs,
+                                 task->accel.locality.cores.ulongs);
+
+        if (!hwloc_bitmap_intersects(cpu_core_bitmap, tmp_bitmap))
+            hint_set(&task->detected_hints, HINT_DISTANT_CPU_GPU);
+
+        hwloc_bitmap_free(cpu_core_bitmap);
+    }
+
     hwloc_bitmap_free(tmp_bitmap);
     hwloc_bitmap_free(cpu_numa_bitmap);
     hwloc_bitmap_free(nic_numa_bitmap);
@@ -225,3 +296,26 @@ void hpcat_hint_format(char *output_str, const char detected_hints)
         }
     }
 }
+
+/**
+ * Identifier of a hint, stable across releases for machine-readable outputs.
+ *
+ * @param type[in]            Hint type
+ * @return                    Hint identifier
+ */
+const char *hpcat_hint_code(const HintType_t type)
+{
+    return hint_code[type];
+}
+
+/**
+ * Tells whether a hint is part of a set of detected hints.
+ *
+ * @param detected_hints[in]  Bitfield containing all detected hint flags
+ * @param type[in]            Hint type
+ * @return                    True if the hint was detected
+ */
+bool hpcat_hint_is_set(const char detected_hints, const HintType_t type)
+{
+    return hint_is_set(detected_hints, type);
+}
@@ -37,6 +37,8 @@ typedef enum HintType
     HINT_DIFFERENT_CPU_GPU_NUMA,  /* Different NUMA for CPU and GPU           */
     HINT_DIFFERENT_CPU_NIC_NUMA,  /* Different NUMA for CPU and NIC           */
     HINT_DIFFERENT_GPU_NIC_NUMA,  /* Different NUMA for GPU and NIC           */
+    HINT_DISTANT_CPU_GPU,         /* Same NUMA but not the closest CPU cores  */
+    HINT_CLOSER_NIC,              /* Another NIC has a shorter PCIe path      */
     HINT_MAX
 } HintType_t;
 
@@ -46,8 +48,12 @@ static inline bool hint_is_empty(const char detected_hints)
 }
 
 void hpcat_hint_global_check(Hpcat *hpcat, Task *task);
+void hpcat_hint_node_check(Hpcat *hpcat, Task *task, const unsigned long *prev_ulongs,
+                           const int num_ulongs);
 void hpcat_hint_task_check(Hpcat *hpcat, Task *task);
 void hpcat_hint_task_superscript(char *output_str, const char detected_hints);
 void hpcat_hint_format(char *output_str, const char detected_hints);
+const char *hpcat_hint_code(const HintType_t type);
+bool hpcat_hint_is_set(const char detected_hints, const HintType_t type);
 
 #endif /* HPCAT_HINT_H */
@@ -24,7 +24,9 @@
 * URL       https://github.com/HewlettPackard/hpcat
 ******************************************************************************/
 
+#define _GNU_SOURCE  /* dlinfo, memfd_create */
 #include <dlfcn.h>
+#include <link.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
@@ -36,55 +38,55 @@
 #include <net/if.h>
 #include <netpacket/packet.h>
 #include <dirent.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 
 #include "hpcat.h"
+#include "accel.h"
 #include "common.h"
 #include "settings.h"
 #include "output.h"
+#include "outbuf.h"
 #include "hint.h"
+#include "locality.h"
+#include "pcie.h"
+#include "task.h"
+#include "trace.h"
+#include "mpiio.h"
+#include "dump.h"
+#include "diff.h"
+#include "expect.h"
+#include "predict.h"
 
 #define AMA_GROUP_SHIFTS   11 /* Position of Dragonfly group id in a Slingshot MAC address */
-#define FABRIC_GROUPS_MAX 256
-
-#define MPI_CHECK(x)                                                                       \
-        do {                                                                               \
-            const int err = x;                                                             \
-            if (x != MPI_SUCCESS) {                                                        \
-                int len; char estr[MPI_MAX_ERROR_STRING];                                  \
-                MPI_Error_string(err, estr, &len);                                         \
-                FATAL("Error: MPI error %d at %d: %s. Exiting.\n", err, __LINE__, estr);   \
-            }                                                                              \
-        } while(0)
 
-hwloc_topology_t topology;
+#define ACCEL_MODULE_MOCK   0
 
-static void serialize_bitmap(Bitmap *bitmap, hwloc_bitmap_t tmp)
+/* Accelerator modules, the vendor library they depend on (NULL if none) and the
+ * backend linked in the binary if built with static backends (NULL otherwise) */
+static const struct
 {
-    bitmap->num_ulongs = hwloc_bitmap_nr_ulongs(tmp);
-    if (bitmap->num_ulongs <= 0)
-        FATAL("Error: unable to evaluate qty of ulongs needed to serialize the bitmap. Exiting.\n");
-
-    if (bitmap->num_ulongs > BITMAP_ULONGS_MAX)
-        FATAL("Error: bitmap size is too small. Exiting.\n");
-
-    if (hwloc_bitmap_to_ulongs(tmp, bitmap->num_ulongs, bitmap->ulongs) != 0)
-        FATAL("Error: unable to convert bitmap to ulongs. Exiting.\n");
-}
-
-static void serialize_cpu_bitmap(CPUBitmap *bitmap, hwloc_bitmap_t tmp)
+    const char         *check_lib;
+    const char         *dyn_module;
+    const AccelBackend *builtin;
+} accel_modules[PROBE_MODULES_MAX] =
 {
-    bitmap->num_ulongs = hwloc_bitmap_nr_ulongs(tmp);
-    if (bitmap->num_ulongs <= 0)
-        FATAL("Error: unable to convert cpu bitmap to ulongs. Exiting.\n");
+    { NULL,                "libhpcatmock.so", ACCEL_MOCK_BACKEND },  /* ACCEL_MODULE_MOCK */
+    { "libamdhip64.so",    "libhpcathip.so",  ACCEL_HIP_BACKEND  },
+    { "libnvidia-ml.so",   "libhpcatnvml.so", ACCEL_NVML_BACKEND },
+    { "libze_loader.so.1", "libhpcatze.so",   ACCEL_ZE_BACKEND   },
+};
 
-    if (bitmap->num_ulongs > BITMAP_CPU_ULONGS_MAX)
-        FATAL("Error: cpu bitmap size is too small. Exiting.\n");
+hwloc_topology_t topology;
 
-    if (hwloc_bitmap_to_ulongs(tmp, bitmap->num_ulongs, bitmap->ulongs) != 0)
-        FATAL("Error: unable to convert cpu bitmap to ulongs. Exiting.\n");
-}
+#if MPI_VERSION >= 4
+static MPI_Session session = MPI_SESSION_NULL;
+#endif
 
-static void emulate_mpich_ofi_nic_policy_gpu(Hpcat *hpcat, Task *task, void* dlopen_handle)
+static void emulate_mpich_ofi_nic_policy_gpu(Task *task, const AccelBackend *backend,
+                                             const NodeProbe *probe)
 {
     /* XXX: When using Slingshot with Cray MPICH, setting the environment variable
      * MPICH_OFI_NIC_POLICY to GPU enables this function to emulate NIC affinity
@@ -95,7 +97,7 @@ static void emulate_mpich_ofi_nic_policy_gpu(Hpcat *hpcat, Task *task, void* dlo
     const bool nic_is_cxi = (strstr(task->nic.name, "cxi") != NULL);
 
     /* Only display NIC locality display is emulation is possible */
-    task->nic.numa_affinity = -1;
+    task->nic.numa_affinity.num_ulongs = 0;
     task->nic.name[0] = '\0';
 
     /* Ensure a Slingshot interface is used, otherwise skip emulation */
@@ -103,47 +105,26 @@ static void emulate_mpich_ofi_nic_policy_gpu(Hpcat *hpcat, Task *task, void* dlo
         return;
 
     /* Get the NUMA locality of the first GPU */
-    int (*numa_first)(void) = dlsym(dlopen_handle, "hpcat_accel_numa_first");
-    char *error;
-    if ((error = dlerror()) != NULL)
-        FATAL("Error: unable to load hpcat_accel_numa_first: %s. Exiting.\n", error);
+    const int gpu_numa = backend->numa_first();
 
-    const int gpu_numa = numa_first();
-
-    /* Try now to match the NUMA locality to a Slingshot interface */
-    DIR *dir;
-    struct dirent *entry;
-    char path[PATH_MAX], numa_node_path[PATH_MAX];
-    int nic_numa;
-
-    if ((dir = opendir("/sys/class/net/")) == NULL)
-        FATAL("Error: unable to opendir /sys/class/net. Exiting.\n");
-
-    /* Iterate through each network interface */
-    while ((entry = readdir(dir)) != NULL)
+    /* Try now to match the NUMA locality to a Slingshot interface (scanned by the node leader) */
+    for (int i = 0; i < probe->num_nics; i++)
     {
-        if (strstr(entry->d_name, "hsn") == NULL)
-            continue;
+        const char *nic_name = probe->nics[i].name;
 
-        snprintf(path, sizeof(path), "/sys/class/net/%s/device/", entry->d_name);
-        snprintf(numa_node_path, sizeof(numa_node_path), "%s/numa_node", path);
-
-        FILE *numa_file = fopen(numa_node_path, "r");
-        if (numa_file != NULL)
-        {
-            fscanf(numa_file, "%d", &nic_numa);
-            fclose(numa_file);
-        }
-
-        if (nic_numa == gpu_numa)
+        if (probe->nics[i].numa_node == gpu_numa)
         {
-            sprintf(task->nic.name, "cxi%c", entry->d_name[strlen(entry->d_name) - 1]);
-            task->nic.numa_affinity = gpu_numa;
+            hwloc_bitmap_t numa_affinity = hwloc_bitmap_alloc();
+            if (numa_affinity == NULL)
+                FATAL("Error: unable to allocate NIC NUMA bitmap. Exiting.\n");
+
+            sprintf(task->nic.name, "cxi%c", nic_name[strlen(nic_name) - 1]);
+            hwloc_bitmap_set(numa_affinity, gpu_numa);
+            serialize_bitmap(&task->nic.numa_affinity, numa_affinity);
+            hwloc_bitmap_free(numa_affinity);
             break;
         }
     }
-
-    closedir(dir);
 }
 
 /**
@@ -193,8 +174,8 @@ void get_cpu_numa_affinity(Affinity *affinity)
     }
 
     /* Serialize bitmaps */
-    serialize_cpu_bitmap(&affinity->hw_thread_affinity, hw_thread_affinity);
-    serialize_cpu_bitmap(&affinity->core_affinity, core_affinity);
+    serialize_bitmap(&affinity->hw_thread_affinity, hw_thread_affinity);
+    serialize_bitmap(&affinity->core_affinity, core_affinity);
     serialize_bitmap(&affinity->numa_affinity, numa_affinity);
 
     /* Clean up */
@@ -204,43 +185,19 @@ void get_cpu_numa_affinity(Affinity *affinity)
 }
 
 /**
- * Retrieve accelerator count, PCIe addresses and NUMA node affinities using dyn library
+ * Retrieve accelerator count, PCIe addresses and NUMA node affinities from a backend
  *
  * @param   hpcat[in]        Application handle
  * @param   task[inout]      Task handle
- * @param   check_lib[in]    Path to a library to check if the software stack of a gpu type is available
- * @param   dyn_module[in]   Dynamic library to load if the software stack is available
+ * @param   backend[in]      Accelerator backend (dynamic module or built-in)
+ * @param   probe[in]        Node-level probes
  */
-void try_get_accel_info(Hpcat *hpcat, Task *task, const char *check_lib, const char *dyn_module)
+static void get_accel_info(Hpcat *hpcat, Task *task, const AccelBackend *backend,
+                           const NodeProbe *probe)
 {
-    /* Check if accelerator library is installed */
-    void *handle = dlopen(check_lib, RTLD_LAZY);
-    if (handle == NULL)
-    {
-        VERBOSE(hpcat, "Verbose: %s not found in the search path. Disabling %s.\n", check_lib, dyn_module);
-        return;
-    }
-
-    dlclose(handle);
-
-    /* Get directory path of this binary */
-    char buf[PATH_MAX], *current_path;
-    readlink("/proc/self/exe", buf, PATH_MAX - 1);
-    current_path = dirname(buf);
-
-    /* Get full path where the module is supposed to be stored */
-    char dynlib_path[PATH_MAX];
-    strncpy(dynlib_path, current_path, PATH_MAX - 1);
-    strncat(dynlib_path, "/../lib/", PATH_MAX - 2);
-    strncat(dynlib_path, dyn_module, PATH_MAX - 2 - strlen(dyn_module));
-
-    /* Load dynamic module */
-    handle = dlopen(dynlib_path, RTLD_LAZY);
-    if (handle == NULL)
-    {
-        VERBOSE(hpcat, "Verbose: missing %s module.\n", dynlib_path);
+    const int count = backend->count();
+    if (count <= 0)
         return;
-    }
 
     /* Allocate temporary bitmaps */
     hwloc_bitmap_t numa_affinity = hwloc_bitmap_alloc();
@@ -251,58 +208,127 @@ void try_get_accel_info(Hpcat *hpcat, Task *task, const char *check_lib, const c
     if (visible_devices == NULL)
         FATAL("Error: unable to allocate a hwloc bitmap (visible_devices). Exiting.\n");
 
-    /* Retrieve accelerator information with the dynamic library */
-    char *error;
-    int (*device_count)(void) = dlsym(handle, "hpcat_accel_count");
-    if ((error = dlerror()) != NULL)
-        FATAL("Error: unable to load hpcat_accel_count with dyn library %s: %s. Exiting.\n", dyn_module, error);
-
-    const int count = device_count();
-    if (count <= 0)
-        goto exit;
-
     Accelerators *accel = &task->accel;
     accel->num_accel += count;
 
-    int (*pciaddr_list_str)(char *buff, const int max_buff_size) = dlsym(handle, "hpcat_accel_pciaddr_list_str");
-    if ((error = dlerror()) != NULL)
-        FATAL("Error: unable to load hpcat_accel_pciaddr_list_str with dyn library %s: %s. Exiting.\n", dyn_module, error);
-    pciaddr_list_str(accel->pciaddr, STR_MAX);
+    backend->pciaddr_list_str(accel->pciaddr, STR_MAX);
 
-    int (*numa_bitmap)(hwloc_bitmap_t numa) = dlsym(handle, "hpcat_accel_numa_bitmap");
-    if ((error = dlerror()) != NULL)
-        FATAL("Error: unable to load hpcat_accel_numa_bitmap with dyn library %s: %s. Exiting.\n", dyn_module, error);
-    if (numa_bitmap(numa_affinity) != 0)
-        FATAL("Error: hpcat_accel_numa_bitmap with dyn library %s. Exiting.\n", dyn_module);
+    if ((backend->partition_list_str != NULL) &&
+        (backend->partition_list_str(accel->partition, PARTITION_LIST_MAX) != 0))
+        accel->partition[0] = '\0';
 
-    int (*visible_bitmap)(hwloc_bitmap_t numa) = dlsym(handle, "hpcat_accel_visible_bitmap");
-    if ((error = dlerror()) != NULL)
-        FATAL("Error: unable to load hpcat_accel_visible_bitmap with dyn library %s: %s. Exiting.\n", dyn_module, error);
-    if (visible_bitmap(visible_devices) != 0)
-        FATAL("Error: hpcat_accel_visible_bitmap with dyn library %s. Exiting.\n", dyn_module);
+    if (backend->numa_bitmap(numa_affinity) != 0)
+        FATAL("Error: hpcat_accel_numa_bitmap with %s backend. Exiting.\n", backend->name);
+
+    if (backend->visible_bitmap(visible_devices) != 0)
+        FATAL("Error: hpcat_accel_visible_bitmap with %s backend. Exiting.\n", backend->name);
 
     /* Serialize bitmaps */
     serialize_bitmap(&accel->numa_affinity, numa_affinity);
     serialize_bitmap(&accel->visible_devices, visible_devices);
 
-    VERBOSE(hpcat, "Verbose: %s module enabled.\n", dyn_module);
+    VERBOSE(hpcat, "Verbose: %s backend enabled.\n", backend->name);
 
     if (task->is_mpich_ofi_nic_policy_gpu)
-         emulate_mpich_ofi_nic_policy_gpu(hpcat, task, handle);
+         emulate_mpich_ofi_nic_policy_gpu(task, backend, probe);
 
-exit:
-    dlclose(handle);
     hwloc_bitmap_free(numa_affinity);
     hwloc_bitmap_free(visible_devices);
 }
 
+static void *load_accel_symbol(void *handle, const char *dyn_module, const char *symbol, const bool optional)
+{
+    dlerror();
+
+    void *ptr = dlsym(handle, symbol);
+
+    char *error;
+    if ((error = dlerror()) != NULL && !optional)
+        FATAL("Error: unable to load %s with dyn library %s: %s. Exiting.\n", symbol, dyn_module, error);
+
+    return ptr;
+}
+
 /**
- * Parse buffer to find data after the needle and before a comma
+ * Retrieve accelerator count, PCIe addresses and NUMA node affinities using dyn library
+ *
+ * @param   hpcat[in]        Application handle
+ * @param   task[inout]      Task handle
+ * @param   probe[in]        Node-level probes
+ * @param   module_id[in]    Position of the module in accel_modules
+ */
+static void try_get_accel_info(Hpcat *hpcat, Task *task, const NodeProbe *probe, const int module_id)
+{
+    const ProbeModule *module = &probe->modules[module_id];
+    const char *dyn_module = accel_modules[module_id].dyn_module;
+    const AccelBackend *builtin = accel_modules[module_id].builtin;
+    void *lib_handle = NULL, *handle;
+
+    /* The node leader already checked the vendor library and the module are installed */
+    if (!module->is_available)
+        return;
+
+    /* Load the vendor library from its resolved path, the module dependency then matches it
+     * without searching the library path again */
+    if (module->check_lib[0] != '\0')
+    {
+        lib_handle = dlopen(module->check_lib, RTLD_LAZY);
+        if (lib_handle == NULL)
+            return;
+    }
+
+    /* Built-in backend: only resolve the runtime functions from the vendor library */
+    if (builtin != NULL)
+    {
+        if ((builtin->runtime_load == NULL) || (builtin->runtime_load(lib_handle) == 0))
+            get_accel_info(hpcat, task, builtin, probe);
+        else
+            VERBOSE(hpcat, "Verbose: unable to resolve %s functions from %s.\n",
+                    builtin->name, module->check_lib);
+
+        if (lib_handle != NULL)
+            dlclose(lib_handle);
+        return;
+    }
+
+    /* Load dynamic module */
+    handle = dlopen(module->dyn_module, RTLD_LAZY);
+    if (handle == NULL)
+    {
+        VERBOSE(hpcat, "Verbose: unable to load %s: %s.\n", module->dyn_module, dlerror());
+        if (lib_handle != NULL)
+            dlclose(lib_handle);
+        return;
+    }
+
+    /* Retrieve accelerator information with the dynamic library */
+    const AccelBackend backend =
+    {
+        .name             = dyn_module,
+        .count              = load_accel_symbol(handle, dyn_module, "hpcat_accel_count", false),
+        .pciaddr_list_str   = load_accel_symbol(handle, dyn_module, "hpcat_accel_pciaddr_list_str", false),
+        .numa_bitmap        = load_accel_symbol(handle, dyn_module, "hpcat_accel_numa_bitmap", false),
+        .visible_bitmap     = load_accel_symbol(handle, dyn_module, "hpcat_accel_visible_bitmap", false),
+        .numa_first         = load_accel_symbol(handle, dyn_module, "hpcat_accel_numa_first", false),
+        .partition_list_str = load_accel_symbol(handle, dyn_module, "hpcat_accel_partition_list_str", true),
+    };
+
+    get_accel_info(hpcat, task, &backend, probe);
+
+    dlclose(handle);
+    if (lib_handle != NULL)
+        dlclose(lib_handle);
+}
+
+/**
+ * Parse buffer to find data after the needle and before a comma (or the end of the line),
+ * truncated to max_len - 1 characters
  *
  * @param   dest[out]      Where to store parsed data
  * @param   max_len[in]    Max length of the destination buffer
  * @param   buf[in]        Buffer to parse
  * @param   needle[in]     Keyword to find in the input buffer
+ * @return                 Position after the parsed data, NULL if not found
  */
 const char *parse_buffer(char *dest, const int max_len, const char *buf, const char *needle)
 {
@@ -311,37 +337,212 @@ const char *parse_buffer(char *dest, const int max_len, const char *buf, const c
         return NULL;
 
     pos += strlen(needle);
-    const char *end_pos = strstr(pos, ",");
-    const int len = end_pos - pos;
+    const int len = strcspn(pos, ",)\n");
 
-    if (len >= max_len)
-        return NULL;
+    /* Data longer than the destination is truncated, parsing goes on after it */
+    const int copy_len = (len < max_len) ? len : max_len - 1;
+    memcpy(dest, pos, copy_len);
+    dest[copy_len] = '\0';
+    return pos + len;
+}
+
+/**
+ * Extract all NICs selected by MPI from its verbose output (MPICH_OFI_NIC_VERBOSE),
+ * several with multi-NIC (striping) configurations
+ *
+ * @param   nic[out]    NIC handle
+ * @param   buf[in]     Output of MPI initialization
+ */
+static void parse_mpi_nics(Nic *nic, const char *buf)
+{
+    char name[NIC_STR_MAX], numa_str[NIC_STR_MAX];
+    const char *pos = buf;
+
+    memset(nic, 0, sizeof(Nic));
+
+    hwloc_bitmap_t numa_affinity = hwloc_bitmap_alloc();
+    if (numa_affinity == NULL)
+        FATAL("Error: unable to allocate NIC NUMA bitmap. Exiting.\n");
+
+    while ((pos = parse_buffer(name, NIC_STR_MAX, pos, ", domain_name=")) != NULL)
+    {
+        /* NUMA node reported on the same line */
+        const char *eol = strchr(pos, '\n');
+        const char *numa_pos = parse_buffer(numa_str, NIC_STR_MAX, pos, "numa_node=");
+        if ((numa_pos != NULL) && ((eol == NULL) || (numa_pos < eol)))
+            hwloc_bitmap_set(numa_affinity, atoi(numa_str));
+
+        /* Same NIC reported for several endpoints */
+        char list[NIC_LIST_MAX + 2], item[NIC_STR_MAX + 2];
+        snprintf(list, sizeof(list), ",%s,", nic->name);
+        snprintf(item, sizeof(item), ",%s,", name);
+        if (strstr(list, item) != NULL)
+            continue;
+
+        const int len = strlen(nic->name);
+        if (snprintf(nic->name + len, NIC_LIST_MAX - len, "%s%s", (len > 0) ? "," : "", name) >= NIC_LIST_MAX - len)
+        {
+            nic->name[len] = '\0';
+            break;
+        }
+
+        nic->num_nic++;
+    }
+
+    if (!hwloc_bitmap_iszero(numa_affinity))
+        serialize_bitmap(&nic->numa_affinity, numa_affinity);
 
-    strncpy(dest, pos, len);
-    return end_pos;
+    hwloc_bitmap_free(numa_affinity);
 }
 
 /**
- * Retrieve NIC information by activating verbose flag before calling MPI_Init
+ * Redirect a stream to an anonymous in-memory file (or an unlinked temporary file if
+ * memfd is not available). Unlike a pipe, it never fills up and blocks the writer.
  *
- * @param   task[inout]   Task handle
+ * @param   stream[in]   Stream to redirect
+ * @param   backup[out]  Duplicate of the original file descriptor
+ * @return               File descriptor of the capture
+ */
+static int capture_start(FILE *stream, int *backup)
+{
+    int fd = -1;
+
+#ifdef MFD_CLOEXEC
+    fd = memfd_create("hpcat-capture", MFD_CLOEXEC);
+#endif
+    if (fd == -1)
+    {
+        FILE *file = tmpfile();
+        if (file == NULL)
+            FATAL("Error: unable to create a capture file: %s\n", strerror(errno));
+
+        fd = dup(fileno(file));
+        fclose(file);
+        if (fd == -1)
+            FATAL("Error: dup unable to duplicate capture file: %s\n", strerror(errno));
+    }
+
+    fflush(stream);
+    *backup = dup(fileno(stream));
+    if (*backup == -1)
+        FATAL("Error: dup unable to duplicate stream: %s\n", strerror(errno));
+
+    if (dup2(fd, fileno(stream)) == -1)
+        FATAL("Error: dup2 unable to duplicate stream: %s\n", strerror(errno));
+
+    return fd;
+}
+
+/**
+ * Restore a stream redirected with capture_start and return the captured output
+ *
+ * @param   stream[in]   Redirected stream
+ * @param   backup[in]   Original file descriptor
+ * @param   fd[in]       File descriptor of the capture (closed)
+ * @param   keep[in]     Whether the captured output is returned or discarded
+ * @return               Captured output (NUL terminated, to free), NULL if not needed
+ */
+static char *capture_stop(FILE *stream, const int backup, const int fd, const bool keep)
+{
+    fflush(stream);
+
+    if (dup2(backup, fileno(stream)) == -1)
+        FATAL("Error: unable to restore file descriptor: %s\n", strerror(errno));
+    close(backup);
+
+    char *buf = NULL;
+    struct stat st;
+    if (keep && (fstat(fd, &st) == 0))
+    {
+        buf = malloc(st.st_size + 1);
+        if (buf == NULL)
+            FATAL("Error: unable to allocate capture buffer. Exiting.\n");
+
+        ssize_t len = 0, ret;
+        while ((len < st.st_size) && ((ret = pread(fd, buf + len, st.st_size - len, len)) > 0))
+            len += ret;
+        buf[len] = '\0';
+    }
+
+    close(fd);
+    return buf;
+}
+
+/**
+ * Account the time elapsed since start to a phase (--timings) and trace it (--trace)
+ *
+ * @param   hpcat[inout]  Application handle
+ * @param   phase[in]     Phase
+ * @param   start[in]     Start time (wtime())
+ */
+static void phase_end(Hpcat *hpcat, const Phase_t phase, const double start)
+{
+    const double end = wtime();
+
+    if (hpcat->timings[phase] < 0.0)
+        hpcat->timings[phase] = end - start;
+    else
+        hpcat->timings[phase] += end - start;
+
+    hpcat_trace_add(hpcat, hpcat_phase_str(phase), TRACE_PHASE, start, end);
+}
+
+/**
+ * Initialize MPI and set the communicator of all ranks. With --mpi-sessions, only a
+ * session and a communicator built from the mpi://WORLD process set are created
+ * (MPI-4), MPI_Init is the fallback.
+ *
+ * @param   hpcat[inout]  Application handle
  * @param   nargs[in]     Program argument count
  * @param   args[in]      Program argument vector
  */
-void MPI_Init_verbose(Task *task, int *nargs, char **args[])
+static void mpi_start(Hpcat *hpcat, int *nargs, char **args[])
 {
-    char buf[STR_MAX];
-    int stderr_bk = dup(fileno(stderr));
-    if (stderr_bk == -1)
-        FATAL("Error: dup unable to duplicate stderr: %s\n", strerror(errno));
+    const double start = wtime();
 
-    int pipefd[2];
-    if (pipe(pipefd) == -1)
-        FATAL("Error: unable to create a pipe: %s\n", strerror(errno));
+    hpcat->is_mpi_session = false;
 
-    /* sterr will now go to the pipe */
-    if (dup2(pipefd[1], fileno(stderr)) == -1)
-        FATAL("Error: dup2 unable to duplicate stderr: %s\n", strerror(errno));
+#if MPI_VERSION >= 4
+    if (hpcat->settings.enable_mpi_sessions &&
+        (MPI_Session_init(MPI_INFO_NULL, MPI_ERRORS_RETURN, &session) == MPI_SUCCESS))
+    {
+        MPI_Group group = MPI_GROUP_NULL;
+        if ((MPI_Group_from_session_pset(session, "mpi://WORLD", &group) == MPI_SUCCESS) &&
+            (MPI_Comm_create_from_group(group, "hpcat", MPI_INFO_NULL, MPI_ERRORS_RETURN,
+                                        &hpcat->comm) == MPI_SUCCESS))
+            hpcat->is_mpi_session = true;
+
+        /* The group belongs to the session, free it before finalizing on failure */
+        if (group != MPI_GROUP_NULL)
+            MPI_Group_free(&group);
+
+        if (!hpcat->is_mpi_session)
+            MPI_Session_finalize(&session);
+    }
+#endif
+
+    if (!hpcat->is_mpi_session)
+    {
+        MPI_Init(nargs, args);
+        hpcat->comm = MPI_COMM_WORLD;
+    }
+
+    phase_end(hpcat, PHASE_MPI_INIT, start);
+}
+
+/**
+ * Retrieve NIC information by activating verbose flag before calling MPI_Init
+ *
+ * @param   hpcat[inout]  Application handle
+ * @param   task[inout]   Task handle
+ * @param   nargs[in]     Program argument count
+ * @param   args[in]      Program argument vector
+ */
+void MPI_Init_verbose(Hpcat *hpcat, Task *task, int *nargs, char **args[])
+{
+    /* stderr will now go to the capture file */
+    int stderr_bk;
+    const int capture_fd = capture_start(stderr, &stderr_bk);
 
     /* XXX: Verify that MPICH_OFI_NIC_POLICY=GPU is disabled (emulated if set),
      * as this configuration disrupts the modular functionality of the tool.
@@ -356,69 +557,49 @@ void MPI_Init_verbose(Task *task, int *nargs, char **args[])
     /* Enabling MPI verbosity */
     setenv("MPICH_OFI_NIC_VERBOSE", "2", 1);
 
-    MPI_Init(nargs, args);
-    fflush(stderr);
-
-    close(pipefd[1]);
+    mpi_start(hpcat, nargs, args);
 
     /* Restoring stderr */
-    if (dup2(stderr_bk, fileno(stderr)) == -1)
-        FATAL("Error: unable to restore file descriptor on stderr: %s\n", strerror(errno));
-
-    read(pipefd[0], buf, STR_MAX);
+    char *buf = capture_stop(stderr, stderr_bk, capture_fd, true);
 
     /* Check MPICH NIC selection */
-    memset(&task->nic, 0, sizeof(Nic));
-    const char *nic_pos = parse_buffer(task->nic.name, NIC_STR_MAX, buf, ", domain_name=");
-    if (nic_pos != NULL)
-    {
-        char numa_str[NIC_STR_MAX] = { 0 };
-        const char *numa_pos = parse_buffer(numa_str, NIC_STR_MAX, nic_pos, "numa_node=");
-        if (numa_pos != NULL)
-            task->nic.numa_affinity = (char)atoi(numa_str);
-        task->nic.num_nic = 1;
-    }
+    parse_mpi_nics(&task->nic, buf);
+    free(buf);
 
     unsetenv("MPICH_OFI_NIC_VERBOSE");
 }
 
 /**
  * Discard output in stdout with MPI_Finalize
+ *
+ * @param   hpcat[inout]  Application handle
  */
-void MPI_Finalize_noverbose(void)
+void MPI_Finalize_noverbose(Hpcat *hpcat)
 {
-    int stdout_bk = dup(fileno(stdout));
-    if (stdout_bk == -1)
-        FATAL("Error: dup unable to duplicate stdout: %s\n", strerror(errno));
-
-    int pipefd[2];
-    if (pipe(pipefd) == -1)
-        FATAL("Error: unable to create a pipe: %s\n", strerror(errno));
-
-    if (dup2(pipefd[1], fileno(stdout)) == -1)
-        FATAL("Error: dup2 unable to duplicate stdout: %s\n", strerror(errno));
-
-    MPI_Finalize();
-    fflush(stdout);
+    int stdout_bk;
+    const int capture_fd = capture_start(stdout, &stdout_bk);
 
-    close(pipefd[1]);
+#if MPI_VERSION >= 4
+    if (hpcat->is_mpi_session)
+    {
+        MPI_Comm_free(&hpcat->comm);
+        MPI_Session_finalize(&session);
+    }
+    else
+#endif
+        MPI_Finalize();
 
     /* Restoring stdout */
-    if (dup2(stdout_bk, fileno(stdout)) == -1)
-        FATAL("Error: unable to restore file descriptor on stdout: %s\n", strerror(errno));
+    capture_stop(stdout, stdout_bk, capture_fd, false);
 }
 
 /**
- * Retrieve fabric locality information
+ * Retrieve the Dragonfly group id of this node
  *
- * @param   hpcat[inout]    Application handle
- * @param   task[inout]     Task handle
+ * @return                  Group id or -1 if there is no Slingshot interface
  */
-void try_get_fabric_info(Hpcat *hpcat, Task *task)
+static int get_fabric_group_id(void)
 {
-    if (!hpcat->settings.enable_fabric)
-        return;
-
     /* XXX: For now only detecting HPE Slingshot with Dragonfly topology.
      * The DragonFly group id can be found in the MAC address of a Slingshot NIC */
     struct ifaddrs *ifaddr, *ifa;
@@ -443,15 +624,149 @@ void try_get_fabric_info(Hpcat *hpcat, Task *task)
             FATAL("Error: unable to retrieve %s MAC address\n", ifa->ifa_name);
     }
 
-    if (group_id >= 0)
+    freeifaddrs(ifaddr);
+    return group_id;
+}
+
+/**
+ * List Slingshot interfaces and their NUMA node (for MPICH_OFI_NIC_POLICY=GPU emulation)
+ *
+ * @param   probe[inout]    Node-level probes
+ */
+static void get_slingshot_nics(NodeProbe *probe)
+{
+    DIR *dir;
+    struct dirent *entry;
+    char path[PATH_MAX];
+
+    /* No network interface can be matched (e.g. containers without sysfs) */
+    sysfs_path(path, sizeof(path), "/sys/class/net/");
+    if ((dir = opendir(path)) == NULL)
+        return;
+
+    /* Iterate through each network interface */
+    while ((entry = readdir(dir)) != NULL && probe->num_nics < PROBE_NICS_MAX)
     {
-        task->fabric_group_id = group_id;
+        if (strstr(entry->d_name, "hsn") == NULL)
+            continue;
+
+        /* Interface names are shorter than IFNAMSIZ, skip anything longer */
+        ProbeNic *nic = &probe->nics[probe->num_nics];
+        if (snprintf(nic->name, NIC_STR_MAX, "%s", entry->d_name) >= NIC_STR_MAX)
+            continue;
+
+        probe->num_nics++;
+        nic->numa_node = -1;
+
+        sysfs_path(path, sizeof(path), "/sys/class/net/%s/device/numa_node", entry->d_name);
+
+        FILE *numa_file = fopen(path, "r");
+        if (numa_file != NULL)
+        {
+            if (fscanf(numa_file, "%d", &nic->numa_node) != 1)
+                nic->numa_node = -1;
+            fclose(numa_file);
+        }
+    }
+
+    closedir(dir);
+}
+
+/**
+ * Run the probes giving the same result for all ranks of a node: installed
+ * accelerator software stacks, fabric group and Slingshot interfaces. Only
+ * the node leader touches the filesystem, which avoids thousands of dlopen
+ * searches on shared filesystems, then it shares the result with local ranks.
+ *
+ * @param   hpcat[in]       Application handle
+ * @param   probe[out]      Node-level probes
+ * @param   node_comm[in]   Communicator of the ranks on this node
+ * @param   node_rank[in]   Rank in node_comm
+ * @param   request[out]    Pending broadcast of the probes, to complete before use
+ */
+static void node_probe(Hpcat *hpcat, NodeProbe *probe, MPI_Comm node_comm, const int node_rank,
+                       MPI_Request *request)
+{
+    if (node_rank == 0)
+    {
+        memset(probe, 0, sizeof(NodeProbe));
+
+        /* Get directory path of this binary */
+        char buf[PATH_MAX] = { 0 }, *current_path;
+        readlink("/proc/self/exe", buf, PATH_MAX - 1);
+        current_path = dirname(buf);
+
+        for (int i = 0; i < PROBE_MODULES_MAX && hpcat->settings.enable_accel_runtime; i++)
+        {
+            ProbeModule *module = &probe->modules[i];
+            const char *check_lib = accel_modules[i].check_lib;
+            const char *dyn_module = accel_modules[i].dyn_module;
+
+            /* Check if accelerator library is installed (no check for modules without dependencies) */
+            if (check_lib != NULL)
+            {
+                void *handle = dlopen(check_lib, RTLD_LAZY);
+                if (handle == NULL)
+                {
+                    VERBOSE(hpcat, "Verbose: %s not found in the search path. Disabling %s.\n",
+                            check_lib, dyn_module);
+                    continue;
+                }
+
+                /* Keep the resolved path so that other ranks do not search for it */
+                struct link_map *map = NULL;
+                if ((dlinfo(handle, RTLD_DI_LINKMAP, &map) == 0) && (map != NULL) && (map->l_name[0] == '/'))
+                    snprintf(module->check_lib, PATH_MAX, "%s", map->l_name);
+                else
+                    snprintf(module->check_lib, PATH_MAX, "%s", check_lib);
+
+                dlclose(handle);
+            }
+
+            /* Built-in backends do not need any module file */
+            if (accel_modules[i].builtin != NULL)
+            {
+                module->is_available = true;
+                continue;
+            }
+
+            /* Get full path where the module is supposed to be stored */
+            snprintf(module->dyn_module, PATH_MAX, "%s/../lib/%s", current_path, dyn_module);
+            if (access(module->dyn_module, R_OK) != 0)
+            {
+                VERBOSE(hpcat, "Verbose: missing %s module.\n", module->dyn_module);
+                continue;
+            }
+
+            module->is_available = true;
+        }
+
+        probe->fabric_group_id = hpcat->settings.enable_fabric ? get_fabric_group_id() : -1;
+        get_slingshot_nics(probe);
+    }
+
+    MPI_CHECK( MPI_Ibcast(probe, sizeof(NodeProbe), MPI_BYTE, 0, node_comm, request) );
+}
+
+/**
+ * Retrieve fabric locality information
+ *
+ * @param   hpcat[inout]    Application handle
+ * @param   task[inout]     Task handle
+ * @param   probe[in]       Node-level probes
+ */
+void try_get_fabric_info(Hpcat *hpcat, Task *task, const NodeProbe *probe)
+{
+    if (!hpcat->settings.enable_fabric)
+        return;
+
+    if (probe->fabric_group_id >= 0)
+    {
+        task->fabric_group_id = probe->fabric_group_id;
         VERBOSE(hpcat, "Verbose: Slingshot fabric detected and Dragonfly group id found.\n");
     }
     else
         hpcat->settings.enable_fabric = false;
-
-    freeifaddrs(ifaddr);
 }
 
 /**
@@ -463,8 +778,8 @@ void try_get_fabric_info(Hpcat *hpcat, Task *task)
 void hpcat_init(Hpcat *hpcat, Task *task)
 {
     /* Retrieving MPI info */
-    MPI_CHECK( MPI_Comm_size(MPI_COMM_WORLD, &hpcat->num_tasks) );
-    MPI_CHECK( MPI_Comm_rank(MPI_COMM_WORLD, &hpcat->id) );
+    MPI_CHECK( MPI_Comm_size(hpcat->comm, &hpcat->num_tasks) );
+    MPI_CHECK( MPI_Comm_rank(hpcat->comm, &hpcat->id) );
     task->id = hpcat->id;
 
     /* Retrieving MPI distribution and version, only keep first line */
@@ -474,13 +789,37 @@ void hpcat_init(Hpcat *hpcat, Task *task)
     if (ptr != NULL)
         ptr[0] = '\0';
 
+    VERBOSE(hpcat, "Verbose: MPI initialized with %s in %.3f s.\n",
+            hpcat->is_mpi_session ? "MPI_Session_init" : "MPI_Init", hpcat->timings[PHASE_MPI_INIT]);
+    if (hpcat->settings.enable_mpi_sessions && !hpcat->is_mpi_session)
+        VERBOSE(hpcat, "Verbose: MPI sessions unavailable (MPI-%d.%d library), using MPI_Init.\n",
+                MPI_VERSION, MPI_SUBVERSION);
+
     /* Retrieving hostname */
     if (gethostname(task->hostname, HOST_NAME_MAX) != 0)
         FATAL("Error: unable to get host name: %s. Exiting\n", strerror(errno));
 
+    /* Start the exchange of hostnames, it only completes in main() and overlaps with probes
+     * (hostnames are part of the task records with the fused gather) */
+    if (!hpcat->settings.enable_fused_gather)
+    {
+        hpcat->host_map = calloc(hpcat->num_tasks, HOST_NAME_MAX);
+        if (hpcat->host_map == NULL)
+            FATAL("Error: unable to allocate hostname map. Exiting.\n");
+
+        strncpy(hpcat->host_map[task->id], task->hostname, HOST_NAME_MAX - 1);
+        MPI_CHECK( MPI_Iallgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, hpcat->host_map[0], HOST_NAME_MAX,
+                                  MPI_CHAR, hpcat->comm, &hpcat->host_map_req) );
+    }
+
     /* Detect all cores regardless cgroups */
     setenv("HWLOC_THISSYSTEM", "1", 1);
 
+    /* Let hwloc discover the same (possibly relocated) system as other probes */
+    char *sysfs_root = getenv(SYSFS_ROOT_ENV);
+    if (sysfs_root != NULL)
+        setenv("HWLOC_FSROOT", sysfs_root, 0);
+
     /* Loading hwloc topology */
     if (hwloc_topology_init(&topology) != 0)
         FATAL("Error: unable to initialize hwloc. Exiting.\n");
@@ -489,223 +828,758 @@ void hpcat_init(Hpcat *hpcat, Task *task)
      * on the same node. To optimize this, only one rank per node now discovers the topology
      * and shares it with the other ranks on that node. */
     int node_rank, node_size;
-    MPI_Comm node_comm;
-    MPI_CHECK( MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm) );
-    MPI_CHECK( MPI_Comm_rank(node_comm, &node_rank) );
-    MPI_CHECK( MPI_Comm_size(node_comm, &node_size) );
-
+    double start = wtime();
+    MPI_CHECK( MPI_Comm_split_type(hpcat->comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                                   &hpcat->node_comm) );
+    MPI_CHECK( MPI_Comm_rank(hpcat->node_comm, &node_rank) );
+    MPI_CHECK( MPI_Comm_size(hpcat->node_comm, &node_size) );
+    phase_end(hpcat, PHASE_NODE_SPLIT, start);
+
+    /* Large jobs only trace node leaders and a strided sample of ranks */
+    hpcat->is_traced = (node_rank == 0) || (hpcat->num_tasks <= TRACE_RANKS_MAX) ||
+                       (hpcat->id % (hpcat->num_tasks / TRACE_RANKS_MAX) == 0);
+
+    /* PCIe devices and OS devices (e.g. network interfaces) are only needed for I/O locality */
+    if (hpcat->settings.enable_io_locality)
+        hwloc_topology_set_io_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_IMPORTANT);
+
+    /* The topology and the node probes are broadcast in this order with nonblocking
+     * collectives, so that the node leader probes while the topology is being sent */
+    enum { REQ_TOPO_LENGTH, REQ_TOPO_BUFFER, REQ_PROBE, REQ_MAX };
+    MPI_Request node_reqs[REQ_MAX];
+    NodeProbe probe;
+    char *buffer = NULL;
+    int length = 0;
+    double bcast_start;
+
+    start = wtime();
     if (node_rank == 0) /* Local master load the topology */
     {
-        char *buffer = NULL;
-        int length = 0;
+        if (!hpcat_topology_cache_load(hpcat, topology, task->hostname))
+        {
+            if (hwloc_topology_load(topology) != 0)
+                FATAL("Error: unable to load the hwloc topology. Exiting.\n");
 
-        if (hwloc_topology_load(topology) != 0)
-            FATAL("Error: unable to load the hwloc topology. Exiting.\n");
+            hpcat_topology_cache_save(hpcat, topology, task->hostname);
+        }
+        else
+            VERBOSE(hpcat, "Verbose: hwloc topology loaded from the cache.\n");
 
         if (hwloc_topology_export_xmlbuffer(topology, &buffer, &length, 0) != 0)
             FATAL("Error: unable to export the hwloc topology. Exiting.\n");
 
-        MPI_CHECK( MPI_Bcast(&length, 1, MPI_INT, 0, node_comm) );
-        MPI_CHECK( MPI_Bcast(buffer, length, MPI_BYTE, 0, node_comm) );
+        phase_end(hpcat, PHASE_TOPOLOGY, start);
+
+        bcast_start = wtime();
+        MPI_CHECK( MPI_Ibcast(&length, 1, MPI_INT, 0, hpcat->node_comm, &node_reqs[REQ_TOPO_LENGTH]) );
+        MPI_CHECK( MPI_Ibcast(buffer, length, MPI_BYTE, 0, hpcat->node_comm, &node_reqs[REQ_TOPO_BUFFER]) );
 
+        /* Node-invariant probes are run once per node */
+        start = wtime();
+        node_probe(hpcat, &probe, hpcat->node_comm, node_rank, &node_reqs[REQ_PROBE]);
+
+        MPI_CHECK( MPI_Waitall(REQ_MAX, node_reqs, MPI_STATUSES_IGNORE) );
+        phase_end(hpcat, PHASE_NODE_PROBE, start);
+        hpcat_trace_add(hpcat, "topology_bcast", TRACE_COLLECTIVE, bcast_start, wtime());
         hwloc_free_xmlbuffer(topology, buffer);
     }
     else /* Other local ranks receive the topology */
     {
-        int length = 0;
-        MPI_CHECK( MPI_Bcast(&length, 1, MPI_INT, 0, node_comm) );
+        bcast_start = wtime();
+        MPI_CHECK( MPI_Ibcast(&length, 1, MPI_INT, 0, hpcat->node_comm, &node_reqs[REQ_TOPO_LENGTH]) );
+        MPI_CHECK( MPI_Wait(&node_reqs[REQ_TOPO_LENGTH], MPI_STATUS_IGNORE) );
 
-        char *buffer = (char *)malloc(length);
+        buffer = (char *)malloc(length);
         if (buffer == NULL)
             FATAL("Error: unable to allocate hwloc buffer. Exiting.\n");
 
-        MPI_CHECK( MPI_Bcast(buffer, length, MPI_BYTE, 0, node_comm) );
+        MPI_CHECK( MPI_Ibcast(buffer, length, MPI_BYTE, 0, hpcat->node_comm, &node_reqs[REQ_TOPO_BUFFER]) );
+
+        /* Waiting for the node leader is accounted in the node probe and the broadcast */
+        start = wtime();
+        node_probe(hpcat, &probe, hpcat->node_comm, node_rank, &node_reqs[REQ_PROBE]);
+        MPI_CHECK( MPI_Waitall(REQ_MAX - 1, &node_reqs[REQ_TOPO_BUFFER], MPI_STATUSES_IGNORE) );
+        phase_end(hpcat, PHASE_NODE_PROBE, start);
+        hpcat_trace_add(hpcat, "topology_bcast", TRACE_COLLECTIVE, bcast_start, wtime());
 
+        start = wtime();
         if (hwloc_topology_set_xmlbuffer(topology, buffer, length) != 0)
             FATAL("Error: unable to import hwloc XML buffer. Exiting.\n");
 
         if (hwloc_topology_load(topology) != 0)
             FATAL("Error: unable to load the hwloc topology from XML buffer. Exiting.\n");
 
+        phase_end(hpcat, PHASE_TOPOLOGY, start);
         free(buffer);
     }
 
     /* Retrieving NUMA and CPU core affinities */
+    start = wtime();
     get_cpu_numa_affinity(&task->affinity);
+    phase_end(hpcat, PHASE_AFFINITY, start);
 
     memset(&task->accel, 0, sizeof(Accelerators));
 
     /* Checking fabric locality */
-    try_get_fabric_info(hpcat, task);
+    start = wtime();
+    try_get_fabric_info(hpcat, task, &probe);
+    phase_end(hpcat, PHASE_FABRIC, start);
 
-    /* Checking if HIP is available, if so fetch information */
-    try_get_accel_info(hpcat, task, "libamdhip64.so", "libhpcathip.so");
+    /* Checking if mock accelerators are described, then if HIP, CUDA or OneAPI Level Zero
+     * are available, if so fetch information */
+    for (int i = 0; i < PROBE_MODULES_MAX && hpcat->settings.enable_accel_runtime; i++)
+    {
+        if (((i == ACCEL_MODULE_MOCK) && (getenv(MOCK_ACCEL_ENV) == NULL)) || !probe.modules[i].is_available)
+            continue;
 
-    /* Checking if CUDA is available, if so fetch information */
-    try_get_accel_info(hpcat, task, "libnvidia-ml.so", "libhpcatnvml.so");
+        start = wtime();
+        try_get_accel_info(hpcat, task, &probe, i);
+        phase_end(hpcat, PHASE_ACCEL_MOCK + i, start);
+    }
 
-    /* Checking if OneAPI Level Zero is available, if so fetch information */
-    try_get_accel_info(hpcat, task, "libze_loader.so.1", "libhpcatze.so");
+    /* Fall back on sysfs if no vendor runtime reported any accelerator */
+    if (task->accel.num_accel == 0)
+    {
+        start = wtime();
+        get_accel_info(hpcat, task, &accel_sysfs_backend, &probe);
+        phase_end(hpcat, PHASE_ACCEL_SYSFS, start);
+    }
 
-    /* Disable GPUs if no tasks can detect them */
-    int accel_sum = 0;
-    MPI_Allreduce(&task->accel.num_accel, &accel_sum, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-    hpcat->settings.enable_accel = (accel_sum > 0);
+    /* Closest cores and L3 caches of accelerators and NIC */
+    start = wtime();
+    if (hpcat->settings.enable_io_locality)
+        hpcat_locality_get(hpcat, task);
 
-    VERBOSE(hpcat, "Verbose: %d visible accelerators (sum accross all tasks).\n", accel_sum);
+    /* PCIe path between accelerators and NIC (GPUDirect RDMA) */
+    if (hpcat->settings.enable_nic)
+        hpcat_pcie_path_get(hpcat, task);
+    phase_end(hpcat, PHASE_LOCALITY, start);
 
-    if (!hpcat->settings.enable_omp)
-        return;
+    /* Disable GPUs if no tasks can detect them, the reduction overlaps with OpenMP probes
+     * (resolved by rank 0 from the task records with the fused gather) */
+    int accel_sum = 0;
+    MPI_Request accel_req = MPI_REQUEST_NULL;
+    if (!hpcat->settings.enable_fused_gather)
+        MPI_CHECK( MPI_Iallreduce(&task->accel.num_accel, &accel_sum, 1, MPI_INT, MPI_SUM, hpcat->comm,
+                                  &accel_req) );
 
     /* Retrieving OMP CPU affinities and thread IDs */
-    #pragma omp parallel
+    start = wtime();
+    if (hpcat->settings.enable_omp)
     {
-        const int thread_id = omp_get_thread_num();
+        task->threads = calloc(omp_get_max_threads(), sizeof(Thread));
+        if (task->threads == NULL)
+            FATAL("Error: unable to allocate threads buffer. Exiting.\n");
 
-        #pragma omp single
+        #pragma omp parallel
         {
+            const int thread_id = omp_get_thread_num();
+
+            #pragma omp single
             task->num_threads = omp_get_num_threads();
-            if (task->num_threads > THREADS_MAX)
-                FATAL("Error: THREADS_MAX lower than amount of threads. Exiting.\n");
-        }
 
-        Thread *thread = &task->threads[thread_id];
-        thread->id = thread_id;
-        get_cpu_numa_affinity(&thread->affinity);
+            Thread *thread = &task->threads[thread_id];
+            thread->id = thread_id;
+            get_cpu_numa_affinity(&thread->affinity);
+        }
     }
-}
-
-int main(int argc, char* argv[])
-{
-    /* Hide potential Cray warnings */
-    setenv("OMP_WAIT_POLICY", "PASSIVE", 1);
+    phase_end(hpcat, PHASE_AFFINITY, start);
 
-    /* Disable GPU aware MPI to avoid having to link to GTL */
-    unsetenv("MPICH_GPU_SUPPORT_ENABLED");
-
-    Hpcat hpcat = { 0 };
-    Task task = { 0 };
-
-    /* Retrieving user defined parameters passed as arguments */
-    hpcat_settings_init(argc, argv, &hpcat.settings);
-
-    /* Initializing MPI in verbose mode */
-    MPI_Init_verbose(&task, &argc, &argv);
+    if (hpcat->settings.enable_fused_gather)
+        return;
 
-    /* Retrieve MPI, OMP and accelerator based details */
-    hpcat_init(&hpcat, &task);
+    start = wtime();
+    MPI_CHECK( MPI_Wait(&accel_req, MPI_STATUS_IGNORE) );
+    hpcat_trace_add(hpcat, "accel_allreduce", TRACE_COLLECTIVE, start, wtime());
+    hpcat->settings.enable_accel = (accel_sum > 0);
 
-    /* Verify the binding and affinity, and determine whether hints should be displayed */
-    hpcat_hint_task_check(&hpcat, &task);
+    VERBOSE(hpcat, "Verbose: %d visible accelerators (sum accross all tasks).\n", accel_sum);
+}
 
-    /* Mapping between hostname and ranks */
-    char map[hpcat.num_tasks][HOST_NAME_MAX];
-    strncpy(map[task.id], task.hostname, HOST_NAME_MAX - 1);
-    MPI_CHECK( MPI_Allgather(MPI_IN_PLACE, 0, 0, map[0], HOST_NAME_MAX, MPI_CHAR, MPI_COMM_WORLD) );
+/**
+ * Group ranks per node using the hostname of each rank (hpcat->host_map), and disable
+ * NIC and fabric affinities if all ranks run on a single node
+ *
+ * @param   hpcat[inout]              Application handle
+ * @param   reordered_ranks[out]      Ranks of a node before going to the next one
+ * @param   is_first_node_rank[out]   For each rank, whether it is the first one of its node
+ */
+static void map_nodes(Hpcat *hpcat, int *reordered_ranks, bool *is_first_node_rank)
+{
+    char (*map)[HOST_NAME_MAX] = hpcat->host_map;
 
     /* List of nodes */
-    char hostnames[hpcat.num_tasks][HOST_NAME_MAX];
+    char hostnames[hpcat->num_tasks][HOST_NAME_MAX];
     strncpy(hostnames[0], map[0], HOST_NAME_MAX - 1);
-    hpcat.num_nodes = 1;
-    for (int i = 1; i < hpcat.num_tasks; i++)
+    hpcat->num_nodes = 1;
+    for (int i = 1; i < hpcat->num_tasks; i++)
     {
         int j;
-        for (j = 0; j < hpcat.num_nodes; j++)
+        for (j = 0; j < hpcat->num_nodes; j++)
         {
             if (strncmp(map[i], hostnames[j], HOST_NAME_MAX - 1) == 0)
                 break;
         }
 
-        if (j == hpcat.num_nodes)
+        if (j == hpcat->num_nodes)
         {
-            strncpy(hostnames[hpcat.num_nodes], map[i], HOST_NAME_MAX - 1);
-            hpcat.num_nodes++;
+            strncpy(hostnames[hpcat->num_nodes], map[i], HOST_NAME_MAX - 1);
+            hpcat->num_nodes++;
         }
     }
 
     /* Disable NIC and fabric affinity if only one node */
-    if (hpcat.num_nodes == 1)
+    if (hpcat->num_nodes == 1)
     {
-        hpcat.settings.enable_nic = false;
-        hpcat.settings.enable_fabric = false;
+        hpcat->settings.enable_nic = false;
+        hpcat->settings.enable_fabric = false;
     }
 
     /* Reordered list of ranks ( all ranks on a node before going to the next one) */
-    int reordered_ranks[hpcat.num_tasks];
     int pos = 0;
-    task.is_first_node_rank = false;
-    for (int i = 0; i < hpcat.num_nodes; i++)
+    for (int i = 0; i < hpcat->num_nodes; i++)
     {
-        bool is_first_node_rank = true;
-        for (int j = 0; j < hpcat.num_tasks; j++)
+        bool is_first = true;
+        for (int j = 0; j < hpcat->num_tasks; j++)
         {
             if (strncmp(hostnames[i], map[j], HOST_NAME_MAX - 1) == 0)
             {
-                if (is_first_node_rank)
-                {
-                    if (j == task.id)
-                        task.is_first_node_rank = true;
-
-                    is_first_node_rank = false;
-                }
+                is_first_node_rank[j] = is_first;
+                is_first = false;
                 reordered_ranks[pos] = j;
                 pos++;
             }
         }
     }
+}
 
-    task.is_first_rank = (task.id == reordered_ranks[0]);
-    task.is_last_rank = (task.id == reordered_ranks[hpcat.num_tasks - 1]);
+/**
+ * Resolve the global flags, hints and node mapping from the task records of all ranks
+ * (rank 0 with a fused gather, or a replay)
+ *
+ * @param   hpcat[inout]              Application handle
+ * @param   tasks[inout]              Task records, indexed by rank
+ * @param   reordered_ranks[out]      Ranks of a node before going to the next one
+ * @param   is_first_node_rank[out]   For each rank, whether it is the first one of its node
+ */
+static void resolve_tasks(Hpcat *hpcat, Task *tasks, int *reordered_ranks, bool *is_first_node_rank)
+{
+    hpcat->host_map = calloc(hpcat->num_tasks, HOST_NAME_MAX);
+    if (hpcat->host_map == NULL)
+        FATAL("Error: unable to allocate hostname map. Exiting.\n");
 
+    /* Disable GPUs if no tasks can detect them */
+    int accel_sum = 0;
+    for (int i = 0; i < hpcat->num_tasks; i++)
+        accel_sum += tasks[i].accel.num_accel;
+
+    hpcat->settings.enable_accel = (accel_sum > 0);
+    VERBOSE(hpcat, "Verbose: %d visible accelerators (sum accross all tasks).\n", accel_sum);
+
+    const double start = wtime();
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        hpcat_hint_task_check(hpcat, &tasks[i]);
+        strncpy(hpcat->host_map[i], tasks[i].hostname, HOST_NAME_MAX - 1);
+    }
+    phase_end(hpcat, PHASE_HINTS, start);
+
+    map_nodes(hpcat, reordered_ranks, is_first_node_rank);
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        tasks[i].is_first_node_rank = is_first_node_rank[i];
+        tasks[i].is_first_rank = (i == reordered_ranks[0]);
+        tasks[i].is_last_rank = (i == reordered_ranks[hpcat->num_tasks - 1]);
+    }
+}
+
+/**
+ * Cores used by the previous ranks of the node (prefix reduction over node_comm),
+ * for the cross-task hints of the parallel output
+ *
+ * @param   hpcat[in]         Application handle
+ * @param   task[in]          Task handle
+ * @param   num_ulongs[out]   Size of the returned bitmap
+ * @return                    Bitmap to free, NULL on the first rank of the node
+ */
+static unsigned long *node_prev_cores(Hpcat *hpcat, const Task *task, int *num_ulongs)
+{
+    const Bitmap *cores = &task->affinity.core_affinity;
+    int node_rank;
+
+    MPI_CHECK( MPI_Comm_rank(hpcat->node_comm, &node_rank) );
+    MPI_CHECK( MPI_Allreduce(&cores->num_ulongs, num_ulongs, 1, MPI_INT, MPI_MAX, hpcat->node_comm) );
+
+    unsigned long *task_ulongs = calloc(*num_ulongs + 1, sizeof(unsigned long));
+    unsigned long *prev_ulongs = calloc(*num_ulongs + 1, sizeof(unsigned long));
+    if ((task_ulongs == NULL) || (prev_ulongs == NULL))
+        FATAL("Error: Unable to allocate core bitmaps for hints. Exiting.\n");
+
+    memcpy(task_ulongs, cores->ulongs, cores->num_ulongs * sizeof(unsigned long));
+    MPI_CHECK( MPI_Exscan(task_ulongs, prev_ulongs, *num_ulongs, MPI_UNSIGNED_LONG, MPI_BOR,
+                          hpcat->node_comm) );
+    free(task_ulongs);
+
+    /* The result of the exclusive scan is undefined on the first rank */
+    if (node_rank == 0)
+    {
+        free(prev_ulongs);
+        return NULL;
+    }
+
+    return prev_ulongs;
+}
+
+/**
+ * Gather the task records of all ranks on rank 0. Records have variable sizes
+ * (bitmaps and threads are sized from the machine), they are packed and gathered
+ * after their sizes.
+ *
+ * @param   hpcat[in]    Application handle
+ * @param   task[in]     Task handle
+ * @return               Rank 0: task records indexed by rank, others: NULL
+ */
+static Task *gather_tasks(Hpcat *hpcat, const Task *task)
+{
+    const bool is_root = (hpcat->id == 0);
+    int *sizes = NULL, *displs = NULL;
+    char *records = NULL;
     Task *tasks = NULL;
-    if (task.is_first_rank)
+
+    const size_t pack_size = hpcat_task_pack_size(task);
+    if (pack_size > INT_MAX)
+        FATAL("Error: task record too large (%zu bytes). Exiting.\n", pack_size);
+
+    int size = (int)pack_size;
+    char *buffer = malloc(size);
+    if (buffer == NULL)
+        FATAL("Error: unable to allocate task record. Exiting.\n");
+
+    hpcat_task_pack(task, buffer);
+
+    if (is_root)
     {
-        tasks = malloc(sizeof(Task) * hpcat.num_tasks);
-        if (tasks == NULL)
+        sizes = malloc(hpcat->num_tasks * sizeof(int));
+        displs = malloc(hpcat->num_tasks * sizeof(int));
+        tasks = calloc(hpcat->num_tasks, sizeof(Task));
+        if ((sizes == NULL) || (displs == NULL) || (tasks == NULL))
             FATAL("Error: unable to allocate tasks buffer. Exiting.\n");
     }
 
-    MPI_CHECK( MPI_Gather(&task, sizeof(Task), MPI_BYTE, tasks, sizeof(Task), MPI_BYTE, 0, MPI_COMM_WORLD) );
+    MPI_CHECK( MPI_Gather(&size, 1, MPI_INT, sizes, 1, MPI_INT, 0, hpcat->comm) );
 
-    if (task.is_first_rank)
+    size_t total = 0;
+    if (is_root)
     {
-        char groups[FABRIC_GROUPS_MAX] = { 0 };
+        for (int i = 0; i < hpcat->num_tasks; i++)
+        {
+            if (total > INT_MAX)
+                FATAL("Error: task records exceed the size of a gather. Exiting.\n");
 
-        for (int i = 0; i < hpcat.num_tasks; i++)
+            displs[i] = (int)total;
+            total += sizes[i];
+        }
+
+        records = malloc(total);
+        if (records == NULL)
+            FATAL("Error: unable to allocate tasks buffer. Exiting.\n");
+    }
+
+    MPI_CHECK( MPI_Gatherv(buffer, size, MPI_BYTE, records, sizes, displs, MPI_BYTE, 0, hpcat->comm) );
+
+    if (is_root)
+    {
+        for (int i = 0; i < hpcat->num_tasks; i++)
+            hpcat_task_unpack(&tasks[i], records + displs[i]);
+
+        VERBOSE(hpcat, "Verbose: %zu bytes gathered from %d tasks.\n", total, hpcat->num_tasks);
+    }
+
+    free(buffer);
+    free(records);
+    free(sizes);
+    free(displs);
+
+    return tasks;
+}
+
+/**
+ * Reduce the timings of all ranks to min/avg/max per phase, ranks which did not run
+ * a phase are ignored.
+ *
+ * @param   hpcat[in]     Application handle
+ * @param   timings[in]   Timings indexed by rank then phase (-1 if not run)
+ * @param   stats[out]    Statistics of each phase
+ */
+static void timings_stats(const Hpcat *hpcat, const double *timings, PhaseStats stats[PHASE_MAX])
+{
+    for (int phase = 0; phase < PHASE_MAX; phase++)
+    {
+        PhaseStats *s = &stats[phase];
+        double sum = 0.0;
+
+        memset(s, 0, sizeof(PhaseStats));
+
+        for (int i = 0; i < hpcat->num_tasks; i++)
         {
-            Task *current_task = &tasks[reordered_ranks[i]];
+            const double t = timings[i * PHASE_MAX + phase];
+            if (t < 0.0)
+                continue;
 
-            /* Count total fabric dragonfly groups */
-            if (hpcat.settings.enable_fabric && !groups[current_task->fabric_group_id])
+            if ((s->num_ranks == 0) || (t < s->min))
+                s->min = t;
+
+            if ((s->num_ranks == 0) || (t > s->max))
             {
-                groups[current_task->fabric_group_id] = 1;
-                hpcat.num_fabric_groups++;
+                s->max = t;
+                s->slowest_rank = i;
             }
 
-            /* Count total OpenMP threads */
-            if (hpcat.settings.enable_omp)
-                hpcat.num_omp_threads += current_task->num_threads;
+            sum += t;
+            s->num_ranks++;
+        }
 
-            hpcat_hint_global_check(&hpcat, current_task);
+        if (s->num_ranks > 0)
+            s->avg = sum / s->num_ranks;
+    }
+}
 
-            /* Print task info */
-            switch (hpcat.settings.output_type)
+/**
+ * Format the gathered task records in the output buffer (rank 0, after MPI_Finalize)
+ *
+ * @param   hpcat[inout]           Application handle
+ * @param   tasks[inout]           Task records, indexed by rank
+ * @param   reordered_ranks[in]    Ranks of a node before going to the next one
+ */
+static void render(Hpcat *hpcat, Task *tasks, const int *reordered_ranks)
+{
+    char groups[FABRIC_GROUPS_MAX] = { 0 };
+
+    /* Display accelerator partitions if any task reported them */
+    for (int i = 0; i < hpcat->num_tasks && !hpcat->settings.enable_partition; i++)
+        hpcat->settings.enable_partition = (tasks[i].accel.partition[0] != '\0');
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        Task *current_task = &tasks[reordered_ranks[i]];
+
+        /* Count total fabric dragonfly groups */
+        if (hpcat->settings.enable_fabric && !groups[current_task->fabric_group_id])
+        {
+            groups[current_task->fabric_group_id] = 1;
+            hpcat->num_fabric_groups++;
+        }
+
+        /* Count total OpenMP threads */
+        if (hpcat->settings.enable_omp)
+            hpcat->num_omp_threads += current_task->num_threads;
+
+        hpcat_hint_global_check(hpcat, current_task);
+
+        /* Print task info */
+        switch (hpcat->settings.output_type)
+        {
+            case STDOUT:
+                hpcat_display_stdout(hpcat, current_task);
+                break;
+            case YAML:
+                hpcat_display_yaml(hpcat, current_task);
+                break;
+            case JSON:
+                hpcat_display_json(hpcat, current_task);
+                break;
+            case JSONL:
+                hpcat_display_jsonl(hpcat, current_task);
+                break;
+        }
+    }
+}
+
+/**
+ * Display records obtained without MPI (--replay, --predict): hints are checked again,
+ * then the records are rendered on the standard output and released.
+ *
+ * @param   hpcat[inout]    Application handle
+ * @param   tasks[in]       Records of all tasks, indexed by rank
+ * @return                  Exit code: 1 if expectations are not met (--expect), 0 otherwise
+ */
+static int display_offline(Hpcat *hpcat, Task *tasks)
+{
+    int reordered_ranks[hpcat->num_tasks];
+    bool is_first_node_rank[hpcat->num_tasks];
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+        tasks[i].detected_hints = 0;
+
+    resolve_tasks(hpcat, tasks, reordered_ranks, is_first_node_rank);
+
+    hpcat_out_init(&hpcat->out, STDOUT_FILENO);
+    render(hpcat, tasks, reordered_ranks);
+    hpcat_display_close(hpcat);
+    hpcat_out_flush(&hpcat->out);
+    hpcat_out_free(&hpcat->out);
+
+    int exit_code = 0;
+    if ((hpcat->num_expectations > 0) && (hpcat_expect_check(hpcat, tasks) > 0))
+        exit_code = 1;
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+        hpcat_task_free(&tasks[i]);
+    free(tasks);
+    free(hpcat->host_map);
+
+    return exit_code;
+}
+
+/**
+ * Compare two saved runs (--diff), without MPI. Each run is resolved with its own
+ * collection settings and its hints are checked again, including the cross-task ones.
+ *
+ * @param   hpcat[inout]    Application handle
+ * @return                  Exit code: 0 if the runs match, 1 otherwise
+ */
+static int diff(Hpcat *hpcat)
+{
+    Hpcat runs[2];
+    Task *tasks[2];
+    int *reordered_ranks[2];
+
+    for (int i = 0; i < 2; i++)
+    {
+        runs[i] = *hpcat;
+        tasks[i] = hpcat_dump_load(&runs[i], hpcat->settings.diff_files[i]);
+
+        reordered_ranks[i] = malloc(runs[i].num_tasks * sizeof(int));
+        bool *is_first_node_rank = malloc(runs[i].num_tasks * sizeof(bool));
+        if ((reordered_ranks[i] == NULL) || (is_first_node_rank == NULL))
+            FATAL("Error: unable to allocate node mapping. Exiting.\n");
+
+        for (int j = 0; j < runs[i].num_tasks; j++)
+            tasks[i][j].detected_hints = 0;
+
+        resolve_tasks(&runs[i], tasks[i], reordered_ranks[i], is_first_node_rank);
+
+        for (int j = 0; j < runs[i].num_tasks; j++)
+            hpcat_hint_global_check(&runs[i], &tasks[i][reordered_ranks[i][j]]);
+
+        free(is_first_node_rank);
+    }
+
+    hpcat_out_init(&hpcat->out, STDOUT_FILENO);
+    const int num_diffs = hpcat_diff(hpcat, runs, tasks, reordered_ranks);
+    hpcat_out_flush(&hpcat->out);
+    hpcat_out_free(&hpcat->out);
+
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < runs[i].num_tasks; j++)
+            hpcat_task_free(&tasks[i][j]);
+        free(tasks[i]);
+        free(reordered_ranks[i]);
+        free(runs[i].host_map);
+    }
+
+    return (num_diffs > 0) ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    /* Hide potential Cray warnings */
+    setenv("OMP_WAIT_POLICY", "PASSIVE", 1);
+
+    /* Disable GPU aware MPI to avoid having to link to GTL */
+    unsetenv("MPICH_GPU_SUPPORT_ENABLED");
+
+    Hpcat hpcat = { 0 };
+    Task task = { 0 };
+    int exit_code = 0;
+
+    /* Retrieving user defined parameters passed as arguments */
+    hpcat_settings_init(argc, argv, &hpcat.settings);
+
+    for (int i = 0; i < PHASE_MAX; i++)
+        hpcat.timings[i] = -1.0;
+
+    /* Rules are checked once the records are gathered, a wrong specification fails early */
+    if (hpcat.settings.expect_spec != NULL)
+        hpcat_expect_parse(&hpcat, hpcat.settings.expect_spec);
+
+    /* Collection settings of a saved run come from the file, display settings from the command line */
+    if (hpcat.settings.replay_file != NULL)
+        return display_offline(&hpcat, hpcat_dump_load(&hpcat, hpcat.settings.replay_file));
+
+    if (hpcat.settings.predict_tasks > 0)
+        return display_offline(&hpcat, hpcat_predict(&hpcat));
+
+    if (hpcat.settings.diff_files[0] != NULL)
+        return diff(&hpcat);
+
+    /* Trace events are recorded with the monotonic clock and shifted to the wall clock,
+     * which is the only time base shared by all nodes */
+    struct timespec realtime, monotonic;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+    hpcat.clock_offset = (realtime.tv_sec - monotonic.tv_sec) + (realtime.tv_nsec - monotonic.tv_nsec) * 1e-9;
+
+    /* Initializing MPI in verbose mode */
+    MPI_Init_verbose(&hpcat, &task, &argc, &argv);
+
+    /* Retrieve MPI, OMP and accelerator based details */
+    hpcat_init(&hpcat, &task);
+
+    /* Settings of the collection, saved before the node mapping turns NIC and fabric off */
+    const HpcatSettings_t collection = hpcat.settings;
+
+    int reordered_ranks[hpcat.num_tasks];
+    bool is_first_node_rank[hpcat.num_tasks];
+    Task *tasks = NULL;
+    double start;
+
+    if (hpcat.settings.enable_fused_gather)
+    {
+        /* Only one collective: rank 0 resolves global flags and node mapping from task records */
+        task.is_first_rank = (task.id == 0);
+        start = wtime();
+        tasks = gather_tasks(&hpcat, &task);
+        phase_end(&hpcat, PHASE_GATHER, start);
+
+        if (task.is_first_rank)
+            resolve_tasks(&hpcat, tasks, reordered_ranks, is_first_node_rank);
+    }
+    else
+    {
+        /* Verify the binding and affinity, and determine whether hints should be displayed */
+        start = wtime();
+        hpcat_hint_task_check(&hpcat, &task);
+        phase_end(&hpcat, PHASE_HINTS, start);
+
+        /* Mapping between hostname and ranks (exchange started in hpcat_init) */
+        start = wtime();
+        MPI_CHECK( MPI_Wait(&hpcat.host_map_req, MPI_STATUS_IGNORE) );
+        hpcat_trace_add(&hpcat, "hostname_exchange", TRACE_COLLECTIVE, start, wtime());
+        map_nodes(&hpcat, reordered_ranks, is_first_node_rank);
+
+        task.is_first_node_rank = is_first_node_rank[task.id];
+        task.is_first_rank = (task.id == reordered_ranks[0]);
+        task.is_last_rank = (task.id == reordered_ranks[hpcat.num_tasks - 1]);
+
+        if (hpcat.settings.output_file == NULL)
+        {
+            start = wtime();
+            tasks = gather_tasks(&hpcat, &task);
+            phase_end(&hpcat, PHASE_GATHER, start);
+        }
+        else
+        {
+            /* Parallel output: records are formatted by each rank instead of being gathered */
+            start = wtime();
+            if (hpcat.settings.enable_hints)
             {
-                case STDOUT:
-                    hpcat_display_stdout(&hpcat, current_task);
-                    break;
-                case YAML:
-                    hpcat_display_yaml(&hpcat, current_task);
-                    break;
+                int num_ulongs;
+                unsigned long *prev_ulongs = node_prev_cores(&hpcat, &task, &num_ulongs);
+                hpcat_hint_node_check(&hpcat, &task, prev_ulongs, num_ulongs);
+                free(prev_ulongs);
             }
+            phase_end(&hpcat, PHASE_HINTS, start);
+
+            start = wtime();
+            hpcat_out_init(&hpcat.out, -1);
+            hpcat_display_records(&hpcat, &task);
+            phase_end(&hpcat, PHASE_RENDER, start);
         }
+    }
 
-        fflush(stdout);
-        free(tasks);
+    /* Phase timings of all ranks, the render phase is only known by rank 0 (unless parallel output) */
+    double *timings = NULL;
+    if (hpcat.settings.enable_timings)
+    {
+        if (task.is_first_rank)
+        {
+            timings = malloc(hpcat.num_tasks * PHASE_MAX * sizeof(double));
+            if (timings == NULL)
+                FATAL("Error: unable to allocate timings buffer. Exiting.\n");
+        }
+
+        start = wtime();
+        MPI_CHECK( MPI_Gather(hpcat.timings, PHASE_MAX, MPI_DOUBLE, timings, PHASE_MAX, MPI_DOUBLE,
+                              0, hpcat.comm) );
+        hpcat_trace_add(&hpcat, "timings_gather", TRACE_COLLECTIVE, start, wtime());
     }
 
-    /* Clean up */
+    if (hpcat.settings.output_file != NULL)
+    {
+        PhaseStats stats[PHASE_MAX];
+
+        if (timings != NULL)
+            timings_stats(&hpcat, timings, stats);
+
+        hpcat_mpiio_write(&hpcat, &task, reordered_ranks, (timings != NULL) ? stats : NULL);
+    }
+
+    /* Trace events of all ranks, rank 0 keeps its own to add the render */
+    TraceEvent *trace_events = NULL;
+    int *trace_counts = NULL;
+    if (hpcat.settings.trace_file != NULL)
+        trace_events = hpcat_trace_gather(&hpcat, &trace_counts);
+
+    /* Clean up, only the collection holds the allocation: all ranks leave MPI before
+     * rank 0 formats the output */
+    MPI_Comm_free(&hpcat.node_comm);
     hwloc_topology_destroy(topology);
-    MPI_Finalize_noverbose();
-    return 0;
+    start = wtime();
+    MPI_Finalize_noverbose(&hpcat);
+    hpcat_trace_add(&hpcat, "finalize", TRACE_COLLECTIVE, start, wtime());
+
+    if (task.is_first_rank && (hpcat.settings.output_file == NULL))
+    {
+        if (hpcat.settings.save_file != NULL)
+            hpcat_dump_save(&hpcat, &collection, tasks);
+
+        start = wtime();
+        hpcat_out_init(&hpcat.out, STDOUT_FILENO);
+        render(&hpcat, tasks, reordered_ranks);
+        phase_end(&hpcat, PHASE_RENDER, start);
+
+        if (hpcat.settings.enable_timings)
+        {
+            PhaseStats stats[PHASE_MAX];
+
+            timings[PHASE_RENDER] = hpcat.timings[PHASE_RENDER];
+            timings_stats(&hpcat, timings, stats);
+            hpcat_display_timings(&hpcat, stats, hpcat.host_map);
+        }
+
+        hpcat_display_close(&hpcat);
+
+        /* The whole output is written at once */
+        hpcat_out_flush(&hpcat.out);
+        hpcat_out_free(&hpcat.out);
+
+        if ((hpcat.num_expectations > 0) && (hpcat_expect_check(&hpcat, tasks) > 0))
+            exit_code = 1;
+
+        for (int i = 0; i < hpcat.num_tasks; i++)
+            hpcat_task_free(&tasks[i]);
+        free(tasks);
+    }
+
+    if (task.is_first_rank)
+    {
+        if (hpcat.settings.trace_file != NULL)
+            hpcat_trace_write(&hpcat, trace_events, trace_counts, reordered_ranks, is_first_node_rank);
+
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+            VERBOSE((&hpcat), "Verbose: rank 0 peak RSS: %ld KB.\n", usage.ru_maxrss);
+    }
+
+    hpcat_task_free(&task);
+    free(hpcat.host_map);
+    free(timings);
+    free(trace_events);
+    free(trace_counts);
+    free(hpcat.trace);
+
+    return exit_code;
 }
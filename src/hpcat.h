@@ -28,33 +28,40 @@
 #define HPCAT_H
 
 #include <stdbool.h>
+#include <limits.h>
 #include <hwloc.h>
 #include <mpi.h>
 #include "settings.h"
 
 #define STR_MAX              4096
 #define NIC_STR_MAX            32
-#define BITMAP_ULONGS_MAX       1   /* up to 64 elements */
-#define BITMAP_CPU_ULONGS_MAX  32   /* up du 2K hardware threads */
-#define THREADS_MAX           (BITMAP_CPU_ULONGS_MAX * 64)
+#define NIC_LIST_MAX          128   /* Comma separated NIC names (multi-NIC) */
+#define PARTITION_LIST_MAX    128   /* Comma separated partitions of the visible GPUs */
+#define FABRIC_GROUPS_MAX     256
 
-typedef struct
-{
-    int           num_ulongs;
-    unsigned long ulongs[BITMAP_CPU_ULONGS_MAX];
-} CPUBitmap;
+/* Abort on MPI errors (FATAL from common.h) */
+#define MPI_CHECK(x)                                                                       \
+        do {                                                                               \
+            const int err = x;                                                             \
+            if (err != MPI_SUCCESS) {                                                      \
+                int len; char estr[MPI_MAX_ERROR_STRING];                                  \
+                MPI_Error_string(err, estr, &len);                                         \
+                FATAL("Error: MPI error %d at %d: %s. Exiting.\n", err, __LINE__, estr);   \
+            }                                                                              \
+        } while(0)
 
+/* Serialized hwloc bitmap, sized from the bitmap itself (see task.c for the exchange) */
 typedef struct
 {
     int           num_ulongs;
-    unsigned long ulongs[BITMAP_ULONGS_MAX];
+    unsigned long *ulongs;
 } Bitmap;
 
 typedef struct
 {
     Bitmap    numa_affinity;
-    CPUBitmap hw_thread_affinity;
-    CPUBitmap core_affinity;
+    Bitmap    hw_thread_affinity;
+    Bitmap    core_affinity;
 } Affinity;
 
 typedef struct
@@ -63,19 +70,31 @@ typedef struct
     Affinity affinity;
 } Thread;
 
+/* Closest CPU resources of a device (hwloc I/O tree, --enable-io-locality) */
 typedef struct
 {
-    int  num_nic;
-    char name[NIC_STR_MAX];
-    char numa_affinity;
+    Bitmap    cores;
+    Bitmap    l3;
+} IoLocality;
+
+typedef struct
+{
+    int        num_nic;
+    char       name[NIC_LIST_MAX];  /* Comma separated if MPI selected several NICs */
+    Bitmap     numa_affinity;
+    IoLocality locality;
+    char       gpu_path;        /* PciePath_t between the accelerators and this NIC */
+    bool       has_closer_nic;  /* Another NIC has a shorter PCIe path to the accelerators */
 } Nic;
 
 typedef struct
 {
-    int    num_accel;
-    char   pciaddr[STR_MAX];
-    Bitmap numa_affinity;
-    Bitmap visible_devices;
+    int        num_accel;
+    char       pciaddr[STR_MAX];
+    char       partition[PARTITION_LIST_MAX];
+    Bitmap     numa_affinity;
+    Bitmap     visible_devices;
+    IoLocality locality;
 } Accelerators;
 
 typedef struct
@@ -90,14 +109,127 @@ typedef struct
     int           fabric_group_id;
     Nic           nic;
     int           num_threads;
-    Thread        threads[THREADS_MAX];
+    Thread        *threads;     /* Sized from omp_get_max_threads() */
     Accelerators  accel;
     char          detected_hints;
 } Task;
 
+/* Phases timed on every rank (--timings), accelerator modules follow the order of
+ * the module table in hpcat.c */
+typedef enum Phase
+{
+    PHASE_MPI_INIT = 0,
+    PHASE_NODE_SPLIT,
+    PHASE_TOPOLOGY,       /* Discovery, cache or import of the node topology */
+    PHASE_NODE_PROBE,     /* Vendor libraries, modules and NICs of the node */
+    PHASE_AFFINITY,       /* CPU and OpenMP thread affinities */
+    PHASE_FABRIC,
+    PHASE_ACCEL_MOCK,
+    PHASE_ACCEL_HIP,
+    PHASE_ACCEL_NVML,
+    PHASE_ACCEL_ZE,
+    PHASE_ACCEL_SYSFS,
+    PHASE_LOCALITY,       /* I/O locality and PCIe path */
+    PHASE_HINTS,
+    PHASE_GATHER,
+    PHASE_RENDER,
+    PHASE_MAX
+} Phase_t;
+
+/* Cross-rank statistics of a phase (rank 0) */
+typedef struct
+{
+    int    num_ranks;     /* Ranks which ran the phase */
+    double min;
+    double avg;
+    double max;
+    int    slowest_rank;
+} PhaseStats;
+
+#define TRACE_NAME_MAX     32
+
+typedef enum TraceCategory
+{
+    TRACE_PHASE = 0,
+    TRACE_COLLECTIVE
+} TraceCategory_t;
+
+/* Timeline event of a rank (--trace), times from the wall clock */
+typedef struct
+{
+    char   name[TRACE_NAME_MAX];
+    int    category;      /* TraceCategory_t */
+    double start;
+    double end;
+} TraceEvent;
+
+/* Output formatted in memory and written to a file descriptor in large chunks */
+typedef struct
+{
+    char   *data;
+    size_t size;
+    size_t capacity;
+    int    fd;
+} OutBuffer;
+
+typedef enum ExpectType
+{
+    EXPECT_GPUS = 0,               /* Exact number of visible GPUs per rank */
+    EXPECT_MAX_NUMA,               /* NUMA nodes per rank */
+    EXPECT_MAX_THREADS_PER_CORE,   /* Hardware threads per core of a rank */
+    EXPECT_NO_HINT                 /* Hint not reported (HintType_t, HINT_MAX for any) */
+} ExpectType_t;
+
+/* Placement rule checked on all ranks (--expect) */
+typedef struct
+{
+    int type;     /* ExpectType_t */
+    int value;    /* Limit or hint */
+} Expectation;
+
+#define EXPECTATIONS_MAX   16
+
+#define PROBE_MODULES_MAX   4
+#define PROBE_NICS_MAX     16
+
+/* Accelerator module and the vendor library it depends on */
+typedef struct
+{
+    bool is_available;
+    char check_lib[PATH_MAX];   /* Resolved path of the vendor library (empty if none) */
+    char dyn_module[PATH_MAX];  /* Full path of the hpcat module */
+} ProbeModule;
+
+typedef struct
+{
+    char name[NIC_STR_MAX];
+    int  numa_node;
+} ProbeNic;
+
+/* Node-invariant probes, run by one rank per node and shared with the others */
+typedef struct
+{
+    ProbeModule modules[PROBE_MODULES_MAX];
+    int         fabric_group_id;      /* -1 if no Slingshot interface */
+    int         num_nics;
+    ProbeNic    nics[PROBE_NICS_MAX]; /* Slingshot interfaces (hsn*) */
+} NodeProbe;
+
 typedef struct Hpcat
 {
     HpcatSettings_t  settings;
+    MPI_Comm         comm;                       /* All ranks (MPI_COMM_WORLD or from a session) */
+    MPI_Comm         node_comm;                  /* Ranks sharing this node */
+    bool             is_mpi_session;
+    double           timings[PHASE_MAX];         /* Seconds spent in each phase, -1 if not run */
+    double           clock_offset;               /* Wall clock minus monotonic clock */
+    bool             is_traced;                  /* Events sent to rank 0 (sampled at scale) */
+    int              num_trace_events;
+    int              trace_capacity;
+    TraceEvent      *trace;                      /* Events of this rank (--trace) */
+    OutBuffer        out;                        /* Output of rank 0 (render) */
+    int              num_expectations;
+    Expectation      expectations[EXPECTATIONS_MAX];
     int              num_fabric_groups;
     int              num_nodes;
     int              num_tasks;
@@ -106,6 +238,12 @@ typedef struct Hpcat
     char             detected_hints;
     hwloc_bitmap_t   global_cpu_bitmap;
     char             mpi_version[MPI_MAX_LIBRARY_VERSION_STRING];
+    char             prediction[STR_MAX];        /* Launch settings of --predict, empty otherwise */
+    char             (*host_map)[HOST_NAME_MAX]; /* Hostname of each rank */
+    MPI_Request      host_map_req;               /* Pending exchange of host_map */
 } Hpcat;
 
+void serialize_bitmap(Bitmap *bitmap, hwloc_bitmap_t tmp);
+void nic_first_name(const Nic *nic, char *name);
+
 #endif /* HPCAT_H */
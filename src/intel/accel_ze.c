@@ -26,16 +26,133 @@
 ******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <hwloc.h>
 #include <level_zero/ze_api.h>
 #include <level_zero/zes_api.h>
 #include "common.h"
+#include "dynload.h"
+#include "accel.h"
+
+/* Runtime functions, resolved with dlsym when built in the hpcat binary */
+#define ZE_SYMBOLS(X) \
+        X(zeInit) \
+        X(zeDriverGet) \
+        X(zeDeviceGet) \
+        X(zeDriverGetLastErrorDescription) \
+        X(zeDeviceGetProperties) \
+        X(zeDeviceGetSubDevices) \
+        X(zesDeviceGetProperties) \
+        X(zesDevicePciGetProperties)
+
+ZE_SYMBOLS(DYNLOAD_DECLARE)
+
+typedef struct
+{
+    uint32_t domain;
+    uint32_t bus;
+    char     partition[PCI_STR_MAX];  /* Tile(s) exposed by this device */
+} ZeDevice;
+
+static zes_driver_handle_t *ze_drivers = NULL;
+static zes_device_handle_t *ze_devices = NULL;
+static int ze_devices_count = 0;
+static bool ze_is_init = false;
+
+/* Intel GPUs (or tiles, with ZE_FLAT_DEVICE_HIERARCHY=FLAT) in enumeration order */
+static ZeDevice *ze_intel_devices = NULL;
+static int ze_intel_devices_count = 0;
+
+/**
+ * Describe the tiles exposed by a device: the tile itself when tiles are
+ * enumerated as devices (flat hierarchy), its sub-devices otherwise.
+ *
+ * @param   dev[in]         Level Zero device
+ * @param   partition[out]  Output buffer (empty if the device exposes no tile)
+ */
+static void ze_device_tiles(ze_device_handle_t dev, char *partition)
+{
+    ze_device_properties_t props = { .stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
+    ze_device_handle_t *sub_devices;
+    uint32_t sub_count = 0;
+
+    partition[0] = '\0';
+
+    if (DYNCALL(zeDeviceGetProperties)(dev, &props) != ZE_RESULT_SUCCESS)
+        return;
+
+    if (props.flags & ZE_DEVICE_PROPERTY_FLAG_SUBDEVICE)
+    {
+        snprintf(partition, PCI_STR_MAX - 1, "tile%u", props.subdeviceId);
+        return;
+    }
+
+    if ((DYNCALL(zeDeviceGetSubDevices)(dev, &sub_count, NULL) != ZE_RESULT_SUCCESS) || (sub_count == 0))
+        return;
+
+    sub_devices = malloc(sub_count * sizeof(ze_device_handle_t));
+    if (sub_devices == NULL)
+        return;
+
+    if (DYNCALL(zeDeviceGetSubDevices)(dev, &sub_count, sub_devices) != ZE_RESULT_SUCCESS)
+    {
+        free(sub_devices);
+        return;
+    }
+
+    /* Composite device: list its tiles (e.g. tile0+1), ZE_AFFINITY_MASK may hide some */
+    int len = snprintf(partition, PCI_STR_MAX - 1, "tile");
+    for (uint32_t i = 0; i < sub_count && len < PCI_STR_MAX - 1; i++)
+    {
+        ze_device_properties_t sub_props = { .stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
+        if (DYNCALL(zeDeviceGetProperties)(sub_devices[i], &sub_props) != ZE_RESULT_SUCCESS)
+            sub_props.subdeviceId = i;
+
+        len += snprintf(partition + len, PCI_STR_MAX - 1 - len, "%s%u", (i == 0) ? "" : "+",
+                        sub_props.subdeviceId);
+    }
+
+    free(sub_devices);
+}
+
+/* Record PCIe address and tiles of Intel devices */
+static int ze_devices_table_init(void)
+{
+    ze_intel_devices = calloc(ze_devices_count, sizeof(ZeDevice));
+    if ((ze_devices_count > 0) && (ze_intel_devices == NULL))
+        return -1;
+
+    for (int i = 0; i < ze_devices_count; i++)
+    {
+        zes_device_handle_t dev = ze_devices[i];
+        zes_device_properties_t dev_props;
+        dev_props.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
+
+        if ((DYNCALL(zesDeviceGetProperties)(dev, &dev_props) != ZE_RESULT_SUCCESS) ||
+            !strstr(dev_props.brandName, "Intel"))
+            continue;
 
-zes_driver_handle_t *ze_drivers = NULL;
-zes_device_handle_t *ze_devices = NULL;
-int ze_devices_count = 0;
-bool ze_is_init = false;
+        /* Retrieving the PCIe address (tiles share the address of their package) */
+        zes_pci_properties_t pci_prop;
+        ze_result_t ret = DYNCALL(zesDevicePciGetProperties)(dev, &pci_prop);
+        if (ret != ZE_RESULT_SUCCESS)
+        {
+            const char *estring;
+            DYNCALL(zeDriverGetLastErrorDescription)(ze_drivers[0], &estring);
+            printf("Failed to get PCI info for device %u: %s\n", i, estring);
+            return -1;
+        }
+
+        ZeDevice *intel_dev = &ze_intel_devices[ze_intel_devices_count++];
+        intel_dev->domain = pci_prop.address.domain;
+        intel_dev->bus = pci_prop.address.bus;
+        ze_device_tiles((ze_device_handle_t)dev, intel_dev->partition);
+    }
+
+    return 0;
+}
 
 static int ze_init(void)
 {
@@ -47,12 +164,12 @@ static int ze_init(void)
         goto error;
 
     /* Initialize OneAPI Level Zero */
-    if (zeInit(ZE_INIT_FLAG_GPU_ONLY) != ZE_RESULT_SUCCESS)
+    if (DYNCALL(zeInit)(ZE_INIT_FLAG_GPU_ONLY) != ZE_RESULT_SUCCESS)
         goto error;
 
     /* Retrieve OneAPI Level Zero drivers */
     uint32_t driver_count = 0;
-    ze_result_t ret = zeDriverGet(&driver_count, NULL);
+    ze_result_t ret = DYNCALL(zeDriverGet)(&driver_count, NULL);
     if ((ret != ZE_RESULT_SUCCESS) || (driver_count == 0))
         goto error;
 
@@ -60,16 +177,16 @@ static int ze_init(void)
     if (ze_drivers == NULL)
         goto error;
 
-    ret = zeDriverGet(&driver_count, ze_drivers);
+    ret = DYNCALL(zeDriverGet)(&driver_count, ze_drivers);
     if (ret != ZE_RESULT_SUCCESS)
         goto error;
 
     /* Retrieve OneAPI Level Zero devices */
-    ret = zeDeviceGet(ze_drivers[0], &ze_devices_count, NULL);
+    ret = DYNCALL(zeDeviceGet)(ze_drivers[0], &ze_devices_count, NULL);
     if (ret != ZE_RESULT_SUCCESS)
     {
         const char *estring;
-        zeDriverGetLastErrorDescription(ze_drivers[0], &estring);
+        DYNCALL(zeDriverGetLastErrorDescription)(ze_drivers[0], &estring);
         goto error;
     }
 
@@ -80,14 +197,17 @@ static int ze_init(void)
     if (ze_devices == NULL)
         goto error;
 
-    ret = zeDeviceGet(ze_drivers[0], &ze_devices_count, ze_devices);
+    ret = DYNCALL(zeDeviceGet)(ze_drivers[0], &ze_devices_count, ze_devices);
     if (ret != ZE_RESULT_SUCCESS)
     {
         const char *estring;
-        zeDriverGetLastErrorDescription(ze_drivers[0], &estring);
+        DYNCALL(zeDriverGetLastErrorDescription)(ze_drivers[0], &estring);
         goto error;
     }
 
+    if (ze_devices_table_init() != 0)
+        goto error;
+
     ze_is_init = true;
 
     return 0;
@@ -109,28 +229,12 @@ error:
  */
 int hpcat_accel_count(void)
 {
-    int count = 0;
-
-    if (ze_init() != 0)
-        return -1;
-
-    for (int i = 0; i < ze_devices_count; i++)
-    {
-        zes_device_handle_t dev = ze_devices[i];
-        zes_device_properties_t dev_props;
-        dev_props.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
-
-        if ((zesDeviceGetProperties(dev, &dev_props) == ZE_RESULT_SUCCESS) &&
-            strstr(dev_props.brandName, "Intel"))
-            count++;
-    }
-
-    return count;
+    return (ze_init() == 0) ? ze_intel_devices_count : -1;
 }
 
 /**
  *  Format a list (comma separated) of the PCIe addresses of all
- *  accelerators found.
+ *  accelerators found. Tiles of the same package share an address.
  *
  * @param   buff[out]          Output buffer for the list of addresses
  * @param   max_buff_size[in]  Size of the buffer
@@ -144,47 +248,58 @@ int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
 
     int max_size = max_buff_size - 1;
 
-    uint32_t last_domain = 0, last_bus = 0;
-
-    for (int i = 0; i < ze_devices_count; i++)
+    for (int i = 0; i < dev_count; i++)
     {
         char pci[PCI_STR_MAX] = { 0 };
 
-        zes_device_handle_t dev = ze_devices[i];
-        zes_device_properties_t dev_props;
-        dev_props.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
-
-        if ((zesDeviceGetProperties(dev, &dev_props) != ZE_RESULT_SUCCESS) ||
-            !strstr(dev_props.brandName, "Intel"))
-            continue;
+        snprintf(pci, PCI_STR_MAX - 1, "%s[%01x:%02x]", (buff[0] == '\0') ? "" : ",",
+                                                        ze_intel_devices[i].domain,
+                                                        ze_intel_devices[i].bus);
 
-        /* Retrieving the PCIe address */
-        zes_pci_properties_t pci_prop;
-        ze_result_t ret = zesDevicePciGetProperties(dev, &pci_prop);
-        if (ret != ZE_RESULT_SUCCESS)
-        {
-            const char *estring;
-            zeDriverGetLastErrorDescription(ze_drivers[0], &estring);
-            printf("Failed to get PCI info for device %u: %s\n", i, estring);
+        strncat(buff, pci, max_size);
+        max_size -= strlen(pci);
+        if (max_size <= 0)
             return -1;
-        }
+    }
 
-        zes_pci_address_t *addr = &pci_prop.address;
+    return 0;
+}
 
-        /* Avoid consecutive duplicates (GPU tiles on the same package) */
-        if ((addr->domain == last_domain) && (addr->bus == last_bus))
-            continue;
+/**
+ *  Format a list (comma separated) of the tiles exposed by all accelerators
+ *  found.
+ *
+ * @param   buff[out]          Output buffer for the list of tiles
+ * @param   max_buff_size[in]  Size of the buffer
+ * @return                     Success: 0, Error: -1
+ */
+int hpcat_accel_partition_list_str(char *buff, const int max_buff_size)
+{
+    const int dev_count = hpcat_accel_count();
+    if (dev_count <= 0)
+        return -1;
 
-        snprintf(pci, PCI_STR_MAX - 1, "%s[%01x:%02x]", (buff[0] == '\0') ? "" : ",",
-                                                        addr->domain, addr->bus);
+    bool has_partition = false;
+    for (int i = 0; i < dev_count; i++)
+        has_partition |= (ze_intel_devices[i].partition[0] != '\0');
 
-        strncat(buff, pci, max_size);
-        max_size -= strlen(pci);
+    /* Nothing to report for single tile devices */
+    if (!has_partition)
+        return 0;
+
+    int max_size = max_buff_size - 1;
+
+    for (int i = 0; i < dev_count; i++)
+    {
+        char partition[PCI_STR_MAX + 1] = { 0 };
+
+        snprintf(partition, PCI_STR_MAX, "%s%s", (i == 0) ? "" : ",",
+                 (ze_intel_devices[i].partition[0] != '\0') ? ze_intel_devices[i].partition : "-");
+
+        strncat(buff, partition, max_size);
+        max_size -= strlen(partition);
         if (max_size <= 0)
             return -1;
-
-        last_domain = addr->domain;
-        last_bus = addr->bus;
     }
 
     return 0;
@@ -216,30 +331,10 @@ int hpcat_accel_visible_bitmap(hwloc_bitmap_t bitmap)
  */
 int hpcat_accel_numa_first(void)
 {
-    const int dev_count = hpcat_accel_count();
-    if (dev_count <= 0)
+    if (hpcat_accel_count() <= 0)
         return -1;
 
-    zes_device_handle_t dev = ze_devices[0];
-    zes_device_properties_t dev_props;
-    dev_props.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
-
-    if ((zesDeviceGetProperties(dev, &dev_props) != ZE_RESULT_SUCCESS) ||
-        !strstr(dev_props.brandName, "Intel"))
-            return -1;
-
-    /* Retrieving the PCIe address */
-    zes_pci_properties_t pci_prop;
-    ze_result_t ret = zesDevicePciGetProperties(dev, &pci_prop);
-    if (ret != ZE_RESULT_SUCCESS)
-    {
-        const char *estring;
-        zeDriverGetLastErrorDescription(ze_drivers[0], &estring);
-        printf("Failed to get PCI info for device 0: %s\n", estring);
-        return -1;
-    }
-
-    return get_device_numa_affinity(pci_prop.address.domain, pci_prop.address.bus);
+    return get_device_numa_affinity(ze_intel_devices[0].domain, ze_intel_devices[0].bus);
 }
 
 /**
@@ -254,29 +349,10 @@ int hpcat_accel_numa_bitmap(hwloc_bitmap_t numa_affinity)
     if (dev_count <= 0)
         return -1;
 
-    for (int i = 0; i < ze_devices_count; i++)
+    for (int i = 0; i < dev_count; i++)
     {
-        zes_device_handle_t dev = ze_devices[i];
-        zes_device_properties_t dev_props;
-        dev_props.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
-
-        if ((zesDeviceGetProperties(dev, &dev_props) != ZE_RESULT_SUCCESS) ||
-            !strstr(dev_props.brandName, "Intel"))
-            continue;
-
-        /* Retrieving the PCIe address */
-        zes_pci_properties_t pci_prop;
-        ze_result_t ret = zesDevicePciGetProperties(dev, &pci_prop);
-        if (ret != ZE_RESULT_SUCCESS)
-        {
-            const char *estring;
-            zeDriverGetLastErrorDescription(ze_drivers[0], &estring);
-            printf("Failed to get PCI info for device %u: %s\n", i, estring);
-            return -1;
-        }
-
-        const int numa_node = get_device_numa_affinity(pci_prop.address.domain,
-                                                       pci_prop.address.bus);
+        const int numa_node = get_device_numa_affinity(ze_intel_devices[i].domain,
+                                                       ze_intel_devices[i].bus);
         if (numa_node == -1)
             return -1;
 
@@ -285,3 +361,23 @@ int hpcat_accel_numa_bitmap(hwloc_bitmap_t numa_affinity)
 
     return 0;
 }
+
+#ifdef HPCAT_STATIC_BACKEND
+static int ze_runtime_load(void *lib_handle)
+{
+    ZE_SYMBOLS(DYNLOAD_RESOLVE)
+    return 0;
+}
+
+const AccelBackend HPCAT_STATIC_BACKEND =
+{
+    .name               = "libhpcatze.so (built-in)",
+    .runtime_load       = ze_runtime_load,
+    .count              = hpcat_accel_count,
+    .pciaddr_list_str   = hpcat_accel_pciaddr_list_str,
+    .numa_bitmap        = hpcat_accel_numa_bitmap,
+    .visible_bitmap     = hpcat_accel_visible_bitmap,
+    .numa_first         = hpcat_accel_numa_first,
+    .partition_list_str = hpcat_accel_partition_list_str,
+};
+#endif
@@ -0,0 +1,284 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* locality.c: Device locality from the hwloc I/O tree (cores and L3 caches)
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "locality.h"
+#include "common.h"
+
+extern hwloc_topology_t topology;
+
+#define FNV_OFFSET  0x811c9dc5U
+#define FNV_PRIME   0x01000193U
+
+static uint32_t hash_str(uint32_t hash, const char *str)
+{
+    for (; *str != '\0'; str++)
+        hash = (hash ^ (unsigned char)*str) * FNV_PRIME;
+
+    return hash;
+}
+
+static uint32_t hash_file(uint32_t hash, const char *file_path)
+{
+    char path[PATH_MAX], line[STR_MAX];
+    sysfs_path(path, PATH_MAX - 1, file_path);
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return hash;
+
+    while (fgets(line, STR_MAX, file) != NULL)
+        hash = hash_str(hash, line);
+
+    fclose(file);
+    return hash;
+}
+
+/* The topology changes with the BIOS settings (NPS, SMT), the kernel and hwloc: online CPUs
+ * and NUMA nodes, the kernel and the hwloc version are part of the cache key */
+static uint32_t get_fingerprint(void)
+{
+    char version[PCI_STR_MAX];
+    struct utsname uts;
+    uint32_t hash = FNV_OFFSET;
+
+    snprintf(version, PCI_STR_MAX, "%x", hwloc_get_api_version());
+    hash = hash_str(hash, version);
+
+    if (uname(&uts) == 0)
+    {
+        hash = hash_str(hash, uts.release);
+        hash = hash_str(hash, uts.version);
+    }
+
+    hash = hash_file(hash, "/sys/devices/system/cpu/online");
+    hash = hash_file(hash, "/sys/devices/system/node/online");
+
+    return hash;
+}
+
+static void get_cache_path(char *path, const Hpcat *hpcat, const char *hostname)
+{
+    snprintf(path, PATH_MAX - 1, "%s/%s-%08x%s.xml", hpcat->settings.topology_cache, hostname,
+             get_fingerprint(), hpcat->settings.enable_io_locality ? "-io" : "");
+}
+
+/**
+ * Load the topology of this node from the cache directory if available. Entries
+ * are keyed by host name and a fingerprint of the node configuration (online CPUs
+ * and NUMA nodes, kernel, hwloc version), so a reconfigured node is discovered again.
+ *
+ * @param   hpcat[in]        Application handle
+ * @param   topology[inout]  Initialized (not loaded) topology
+ * @param   hostname[in]     Name of the node
+ * @return                   true if the topology was loaded from the cache
+ */
+bool hpcat_topology_cache_load(Hpcat *hpcat, hwloc_topology_t topology, const char *hostname)
+{
+    char path[PATH_MAX];
+
+    if (hpcat->settings.topology_cache == NULL)
+        return false;
+
+    get_cache_path(path, hpcat, hostname);
+    if (access(path, R_OK) != 0)
+        return false;
+
+    if ((hwloc_topology_set_xml(topology, path) != 0) || (hwloc_topology_load(topology) != 0))
+        FATAL("Error: unable to load the cached hwloc topology %s. Exiting.\n", path);
+
+    return true;
+}
+
+/**
+ * Save the topology of this node in the cache directory (if any)
+ *
+ * @param   hpcat[in]        Application handle
+ * @param   topology[in]     Loaded topology
+ * @param   hostname[in]     Name of the node
+ */
+void hpcat_topology_cache_save(Hpcat *hpcat, hwloc_topology_t topology, const char *hostname)
+{
+    char path[PATH_MAX], tmp_path[PATH_MAX + 16];
+
+    if (hpcat->settings.topology_cache == NULL)
+        return;
+
+    /* Write then rename, so concurrent jobs never read a partial file */
+    get_cache_path(path, hpcat, hostname);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+
+    if (hwloc_topology_export_xml(topology, tmp_path, 0) != 0)
+    {
+        fprintf(stderr, "Warning: unable to write the topology cache %s.\n", tmp_path);
+        return;
+    }
+
+    if (rename(tmp_path, path) != 0)
+        unlink(tmp_path);
+}
+
+/* Find the first PCIe device on a bus (backends only report domain and bus) */
+static hwloc_obj_t get_pcidev_by_bus(const unsigned int domain, const unsigned int bus)
+{
+    hwloc_obj_t obj = NULL;
+
+    while ((obj = hwloc_get_next_pcidev(topology, obj)) != NULL)
+        if ((obj->attr->pcidev.domain == domain) && (obj->attr->pcidev.bus == bus))
+            return obj;
+
+    return NULL;
+}
+
+/* Find an OS device (e.g. network interface) by name */
+static hwloc_obj_t get_osdev_by_name(const char *name)
+{
+    hwloc_obj_t obj = NULL;
+
+    while ((obj = hwloc_get_next_osdev(topology, obj)) != NULL)
+        if ((obj->name != NULL) && (strcmp(obj->name, name) == 0))
+            return obj;
+
+    return NULL;
+}
+
+/**
+ * Add the closest cores (first hardware thread of each core, as in task
+ * affinities) and L3 caches (logical indexes) of a device.
+ *
+ * @param   io_obj[in]    hwloc I/O object
+ * @param   cores[inout]  Closest cores
+ * @param   l3[inout]     Closest L3 caches
+ */
+static void add_locality(hwloc_obj_t io_obj, hwloc_bitmap_t cores, hwloc_bitmap_t l3)
+{
+    hwloc_obj_t ancestor = hwloc_get_non_io_ancestor_obj(topology, io_obj);
+    if ((ancestor == NULL) || (ancestor->cpuset == NULL))
+        return;
+
+    hwloc_obj_t core = NULL;
+    while ((core = hwloc_get_next_obj_inside_cpuset_by_type(topology, ancestor->cpuset,
+                                                            HWLOC_OBJ_CORE, core)) != NULL)
+        hwloc_bitmap_set(cores, core->first_child->os_index);
+
+    /* The ancestor is either inside a L3 (e.g. a CCD) or covers several of them */
+    hwloc_obj_t cache = hwloc_get_ancestor_obj_by_type(topology, HWLOC_OBJ_L3CACHE, ancestor);
+    if (cache != NULL)
+    {
+        hwloc_bitmap_set(l3, cache->logical_index);
+        return;
+    }
+
+    cache = NULL;
+    while ((cache = hwloc_get_next_obj_inside_cpuset_by_type(topology, ancestor->cpuset,
+                                                             HWLOC_OBJ_L3CACHE, cache)) != NULL)
+        hwloc_bitmap_set(l3, cache->logical_index);
+}
+
+static void serialize_locality(IoLocality *locality, hwloc_bitmap_t cores, hwloc_bitmap_t l3)
+{
+    if (hwloc_bitmap_iszero(cores))
+        return;
+
+    serialize_bitmap(&locality->cores, cores);
+
+    if (!hwloc_bitmap_iszero(l3))
+        serialize_bitmap(&locality->l3, l3);
+}
+
+/**
+ * Retrieve the closest cores and L3 caches of the accelerators and the NIC
+ * of a task. Requires a topology loaded with I/O objects.
+ *
+ * @param   hpcat[in]        Application handle
+ * @param   task[inout]      Task handle
+ */
+void hpcat_locality_get(Hpcat *hpcat, Task *task)
+{
+    /* hwloc built without I/O discovery (./configure --enable-io) reports no PCIe device */
+    if (hwloc_get_next_pcidev(topology, NULL) == NULL)
+    {
+        if (hpcat->id == 0)
+            fprintf(stderr, "Warning: no PCIe device in the hwloc topology (hwloc built without I/O "
+                            "support?), I/O locality is not reported.\n");
+        return;
+    }
+
+    hwloc_bitmap_t cores = hwloc_bitmap_alloc();
+    hwloc_bitmap_t l3 = hwloc_bitmap_alloc();
+    if ((cores == NULL) || (l3 == NULL))
+        FATAL("Error: unable to allocate hwloc bitmaps for I/O locality. Exiting.\n");
+
+    /* Accelerators, from the list of PCIe addresses "[d:b],[d:b]" */
+    for (const char *pos = strchr(task->accel.pciaddr, '['); pos != NULL; pos = strchr(pos + 1, '['))
+    {
+        unsigned int domain, bus;
+        if (sscanf(pos, "[%x:%x]", &domain, &bus) != 2)
+            continue;
+
+        hwloc_obj_t obj = get_pcidev_by_bus(domain, bus);
+        if (obj != NULL)
+            add_locality(obj, cores, l3);
+    }
+
+    serialize_locality(&task->accel.locality, cores, l3);
+
+    /* NIC, Cray MPICH reports the CXI domain (cxiN) of the interface hsnN */
+    hwloc_bitmap_zero(cores);
+    hwloc_bitmap_zero(l3);
+
+    if (task->nic.num_nic > 0)
+    {
+        char nic_name[NIC_STR_MAX];
+        nic_first_name(&task->nic, nic_name);
+
+        hwloc_obj_t obj = get_osdev_by_name(nic_name);
+        if ((obj == NULL) && (strncmp(nic_name, "cxi", 3) == 0))
+        {
+            char hsn_name[NIC_STR_MAX];
+            snprintf(hsn_name, NIC_STR_MAX, "hsn%s", nic_name + 3);
+            obj = get_osdev_by_name(hsn_name);
+        }
+
+        if (obj != NULL)
+            add_locality(obj, cores, l3);
+    }
+
+    serialize_locality(&task->nic.locality, cores, l3);
+
+    VERBOSE(hpcat, "Verbose: I/O locality of accelerators and NIC retrieved.\n");
+
+    hwloc_bitmap_free(cores);
+    hwloc_bitmap_free(l3);
+}
@@ -0,0 +1,232 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* accel_mock.c: Dynamic library emulating accelerators from a description file.
+*
+* Each line of the file pointed by HPCAT_MOCK_ACCEL describes a device as
+* "<pci domain>:<pci bus> <numa node>" (hexadecimal PCIe address). A line
+* "visible_env <NAME>" selects the environment variable restricting the
+* visible devices (e.g. ROCR_VISIBLE_DEVICES). Lines starting with '#' are
+* ignored.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <hwloc.h>
+#include "common.h"
+#include "accel.h"
+
+#define LINE_MAX_LEN 256
+
+typedef struct
+{
+    unsigned int domain;
+    unsigned int bus;
+    int          numa_node;
+    bool         is_visible;
+} MockDevice;
+
+static MockDevice *mock_devices = NULL;
+static int mock_devices_count = 0;
+static int mock_devices_capacity = 0;
+static int mock_visible_count = 0;
+static bool mock_is_init = false;
+
+static int mock_init(void)
+{
+    if (mock_is_init)
+        return 0;
+
+    const char *desc_file = getenv(MOCK_ACCEL_ENV);
+    if (desc_file == NULL)
+        return -1;
+
+    FILE *file = fopen(desc_file, "r");
+    if (file == NULL)
+        return -1;
+
+    char line[LINE_MAX_LEN], visible_env[LINE_MAX_LEN] = { 0 };
+    while (fgets(line, LINE_MAX_LEN, file) != NULL)
+    {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        if (sscanf(line, "visible_env %255s", visible_env) == 1)
+            continue;
+
+        if (array_grow(&mock_devices, &mock_devices_capacity, mock_devices_count, sizeof(MockDevice)) != 0)
+        {
+            fclose(file);
+            return -1;
+        }
+
+        MockDevice *dev = &mock_devices[mock_devices_count];
+        if (sscanf(line, "%x:%x %d", &dev->domain, &dev->bus, &dev->numa_node) != 3)
+        {
+            fclose(file);
+            return -1;
+        }
+
+        mock_devices_count++;
+    }
+
+    fclose(file);
+
+    /* Apply the visibility mask if any */
+    hwloc_bitmap_t visible = hwloc_bitmap_alloc();
+    if (visible == NULL)
+        return -1;
+
+    char *visible_list = (visible_env[0] != '\0') ? getenv(visible_env) : NULL;
+    if (visible_list == NULL)
+        set_first_bits_bitmap(visible, mock_devices_count);
+    else if (strlist_to_bitmap(visible, visible_list) != 0)
+        hwloc_bitmap_zero(visible);
+
+    for (int i = 0; i < mock_devices_count; i++)
+    {
+        mock_devices[i].is_visible = hwloc_bitmap_isset(visible, i);
+        if (mock_devices[i].is_visible)
+            mock_visible_count++;
+    }
+
+    hwloc_bitmap_free(visible);
+
+    mock_is_init = true;
+    return 0;
+}
+
+/**
+ * Retrieve how many mock devices are available from this context
+ *
+ * @return                   Quantity of devices found or -1
+ */
+int hpcat_accel_count(void)
+{
+    if (mock_init() != 0)
+        return -1;
+
+    return mock_visible_count;
+}
+
+/**
+ *  Format a list (comma separated) of the PCIe addresses of all
+ *  accelerators found.
+ *
+ * @param   buff[out]          Output buffer for the list of addresses
+ * @param   max_buff_size[in]  Size of the buffer
+ * @return                     Success: 0, Error: -1
+ */
+int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
+{
+    if (hpcat_accel_count() <= 0)
+        return -1;
+
+    int max_size = max_buff_size - 1;
+
+    for (int i = 0; i < mock_devices_count; i++)
+    {
+        char pci[PCI_STR_MAX] = { 0 };
+
+        if (!mock_devices[i].is_visible)
+            continue;
+
+        snprintf(pci, PCI_STR_MAX - 1, "%s[%01x:%02x]", (buff[0] == '\0') ? "" : ",",
+                                                        mock_devices[i].domain, mock_devices[i].bus);
+
+        strncat(buff, pci, max_size);
+        max_size -= strlen(pci);
+        if (max_size <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Retrive a list of visible devices in a bitmap
+ *
+ * @param   bitmap[out]   Preallocated hwloc bitmap
+ * @return                Success: 0, Error: -1
+ */
+int hpcat_accel_visible_bitmap(hwloc_bitmap_t bitmap)
+{
+    if (mock_init() != 0)
+        return -1;
+
+    for (int i = 0; i < mock_devices_count; i++)
+        if (mock_devices[i].is_visible)
+            hwloc_bitmap_set(bitmap, i);
+
+    return 0;
+}
+
+/**
+ * Retrieve the NUMA affinity of the first GPU
+ *
+ * @return                      Success: NUMA node, Error: -1
+ */
+int hpcat_accel_numa_first(void)
+{
+    if (hpcat_accel_count() <= 0)
+        return -1;
+
+    for (int i = 0; i < mock_devices_count; i++)
+        if (mock_devices[i].is_visible)
+            return mock_devices[i].numa_node;
+
+    return -1;
+}
+
+/**
+ * Retrieve a bitmap representing NUMA affinities of all detected accelerators
+ *
+ * @param   numa_affinity[out]  Preallocated hwloc bitmap
+ * @return                      Success: 0, Error: -1
+ */
+int hpcat_accel_numa_bitmap(hwloc_bitmap_t numa_affinity)
+{
+    if (hpcat_accel_count() <= 0)
+        return -1;
+
+    for (int i = 0; i < mock_devices_count; i++)
+        if (mock_devices[i].is_visible)
+            hwloc_bitmap_set(numa_affinity, mock_devices[i].numa_node);
+
+    return 0;
+}
+
+#ifdef HPCAT_STATIC_BACKEND
+const AccelBackend HPCAT_STATIC_BACKEND =
+{
+    .name             = "libhpcatmock.so (built-in)",
+    .count            = hpcat_accel_count,
+    .pciaddr_list_str = hpcat_accel_pciaddr_list_str,
+    .numa_bitmap      = hpcat_accel_numa_bitmap,
+    .visible_bitmap   = hpcat_accel_visible_bitmap,
+    .numa_first       = hpcat_accel_numa_first,
+};
+#endif
@@ -0,0 +1,167 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* mpiio.c: Parallel output in a shared file (MPI-IO).
+*
+* Instead of gathering all task records on rank 0, every rank formats its own
+* records. File offsets are a prefix sum of the record lengths in node order
+* and all ranks write collectively, rank 0 only adds the header and the totals
+* of the job. Formatting and output bandwidth scale with the number of nodes.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpiio.h"
+#include "outbuf.h"
+#include "output.h"
+#include "trace.h"
+#include "common.h"
+
+#define ULONG_BITS      (8 * sizeof(unsigned long))
+#define FLAGS_MAX       (1 + FABRIC_GROUPS_MAX / ULONG_BITS)  /* Hints, then fabric groups */
+
+/**
+ * Reduce the totals of the job on rank 0 (render() resolves them from the gathered
+ * records otherwise)
+ *
+ * @param   hpcat[inout]    Application handle
+ * @param   task[in]        Task of this rank
+ * @param   size[in]        Size of the records of this rank
+ * @return                  Rank 0: total size of the records of all ranks
+ */
+static long long reduce_totals(Hpcat *hpcat, const Task *task, const long long size)
+{
+    long long sums[2] = { size, hpcat->settings.enable_omp ? task->num_threads : 0 };
+    long long totals[2] = { 0 };
+    unsigned long flags[FLAGS_MAX] = { 0 }, global_flags[FLAGS_MAX] = { 0 };
+
+    flags[0] = (unsigned char)task->detected_hints;
+    if ((task->fabric_group_id >= 0) && (task->fabric_group_id < FABRIC_GROUPS_MAX))
+        flags[1 + task->fabric_group_id / ULONG_BITS] |= 1UL << (task->fabric_group_id % ULONG_BITS);
+
+    MPI_CHECK( MPI_Reduce(sums, totals, 2, MPI_LONG_LONG, MPI_SUM, 0, hpcat->comm) );
+    MPI_CHECK( MPI_Reduce(flags, global_flags, FLAGS_MAX, MPI_UNSIGNED_LONG, MPI_BOR, 0, hpcat->comm) );
+
+    hpcat->num_omp_threads = totals[1];
+    hpcat->detected_hints = (char)global_flags[0];
+
+    hwloc_bitmap_t groups = hwloc_bitmap_alloc();
+    if (groups == NULL)
+        FATAL("Error: Unable to allocate temporary bitmap. Exiting.\n");
+
+    hwloc_bitmap_from_ulongs(groups, FLAGS_MAX - 1, &global_flags[1]);
+    hpcat->num_fabric_groups = hwloc_bitmap_weight(groups);
+    hwloc_bitmap_free(groups);
+
+    return totals[0];
+}
+
+/**
+ * Write the output of all ranks in a single file (collective). hpcat->out holds
+ * the records of this rank (hpcat_display_records()) and is released.
+ *
+ * @param   hpcat[inout]            Application handle
+ * @param   task[in]                Task of this rank
+ * @param   reordered_ranks[in]     Ranks of a node before going to the next one
+ * @param   stats[in]               Rank 0: statistics of each phase (--timings), or NULL
+ */
+void hpcat_mpiio_write(Hpcat *hpcat, const Task *task, const int *reordered_ranks, const PhaseStats *stats)
+{
+    const bool is_root = (hpcat->id == 0);
+    const double start = wtime();
+    OutBuffer records = hpcat->out, head, tail;
+
+    /* Header of rank 0, its size shifts the records of all ranks */
+    long long head_size = 0;
+    hpcat_out_init(&hpcat->out, -1);
+    if (is_root)
+        hpcat_display_header(hpcat);
+    head = hpcat->out;
+    head_size = head.size;
+    MPI_CHECK( MPI_Bcast(&head_size, 1, MPI_LONG_LONG, 0, hpcat->comm) );
+
+    /* Offsets follow the node order, no new communicator if it is the rank order */
+    int position = 0;
+    bool is_ordered = true;
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        if (reordered_ranks[i] == hpcat->id)
+            position = i;
+        if (reordered_ranks[i] != i)
+            is_ordered = false;
+    }
+
+    MPI_Comm order_comm = hpcat->comm;
+    if (!is_ordered)
+        MPI_CHECK( MPI_Comm_split(hpcat->comm, 0, position, &order_comm) );
+
+    long long size = records.size, offset = 0;
+    MPI_CHECK( MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, order_comm) );
+    if (position == 0)
+        offset = 0;
+
+    /* Totals (and timings) of rank 0 follow the records */
+    const long long records_size = reduce_totals(hpcat, task, size);
+    hpcat_out_init(&hpcat->out, -1);
+    if (is_root)
+    {
+        hpcat_display_totals(hpcat);
+        if (stats != NULL)
+            hpcat_display_timings(hpcat, stats, hpcat->host_map);
+        hpcat_display_close(hpcat);
+    }
+    tail = hpcat->out;
+
+    MPI_File file;
+    if (MPI_File_open(hpcat->comm, hpcat->settings.output_file, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &file) != MPI_SUCCESS)
+        FATAL("Error: unable to open %s. Exiting.\n", hpcat->settings.output_file);
+
+    MPI_CHECK( MPI_File_set_size(file, 0) );
+
+    if (is_root)
+    {
+        MPI_CHECK( MPI_File_write_at(file, 0, head.data, head.size, MPI_BYTE, MPI_STATUS_IGNORE) );
+        MPI_CHECK( MPI_File_write_at(file, head_size + records_size, tail.data, tail.size, MPI_BYTE,
+                                     MPI_STATUS_IGNORE) );
+    }
+
+    MPI_CHECK( MPI_File_write_at_all(file, head_size + offset, records.data, records.size, MPI_BYTE,
+                                     MPI_STATUS_IGNORE) );
+    MPI_CHECK( MPI_File_close(&file) );
+
+    hpcat_trace_add(hpcat, "output_write", TRACE_COLLECTIVE, start, wtime());
+    VERBOSE(hpcat, "Verbose: %lld bytes written to %s by %d tasks (MPI-IO).\n",
+            head_size + records_size + (long long)tail.size, hpcat->settings.output_file, hpcat->num_tasks);
+
+    if (!is_ordered)
+        MPI_Comm_free(&order_comm);
+
+    hpcat_out_free(&records);
+    hpcat_out_free(&head);
+    hpcat_out_free(&tail);
+    hpcat_out_init(&hpcat->out, -1);
+}
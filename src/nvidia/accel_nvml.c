@@ -26,84 +26,207 @@
 ******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <hwloc.h>
 #include <nvml.h>
 #include "common.h"
+#include "dynload.h"
+#include "accel.h"
+
+/* Runtime functions, resolved with dlsym when built in the hpcat binary */
+#define NVML_SYMBOLS(X) \
+        X(nvmlInit) \
+        X(nvmlDeviceGetCount) \
+        X(nvmlDeviceGetHandleByIndex) \
+        X(nvmlDeviceGetHandleByUUID) \
+        X(nvmlDeviceGetIndex) \
+        X(nvmlDeviceGetPciInfo) \
+        X(nvmlDeviceGetMigMode) \
+        X(nvmlDeviceGetMaxMigDeviceCount) \
+        X(nvmlDeviceGetMigDeviceHandleByIndex) \
+        X(nvmlDeviceGetDeviceHandleFromMigDeviceHandle) \
+        X(nvmlDeviceGetGpuInstanceId) \
+        X(nvmlDeviceGetComputeInstanceId) \
+        X(nvmlDeviceGetName)
+
+NVML_SYMBOLS(DYNLOAD_DECLARE)
+
+typedef struct
+{
+    unsigned int index;                   /* NVML index of the (parent) GPU */
+    unsigned int domain;
+    unsigned int bus;
+    char         partition[PCI_STR_MAX];  /* MIG instance, empty for a full GPU */
+} NvmlDevice;
+
+static NvmlDevice *nvml_devices = NULL;
+static int nvml_devices_count = 0;
+static int nvml_devices_capacity = 0;
+static bool nvml_is_init = false;
+
+/* Append a GPU, or its MIG instance if mig is not NULL, to the device table */
+static int nvml_add_device(nvmlDevice_t device, nvmlDevice_t mig)
+{
+    nvmlPciInfo_t pci_info;
 
-bool nvml_is_init = false;
+    if (array_grow(&nvml_devices, &nvml_devices_capacity, nvml_devices_count, sizeof(NvmlDevice)) != 0)
+        return -1;
 
-static int nvml_init(void)
-{
-    if (nvml_is_init)
-        return 0;
+    NvmlDevice *dev = &nvml_devices[nvml_devices_count];
 
-    if (nvmlInit() != NVML_SUCCESS)
+    if ((DYNCALL(nvmlDeviceGetIndex)(device, &dev->index) != NVML_SUCCESS) ||
+        (DYNCALL(nvmlDeviceGetPciInfo)(device, &pci_info) != NVML_SUCCESS))
         return -1;
 
-    nvml_is_init = true;
+    dev->domain = pci_info.domain;
+    dev->bus = pci_info.bus;
+    dev->partition[0] = '\0';
+
+    if (mig != NULL)
+    {
+        unsigned int gi = 0, ci = 0;
+        char name[NVML_DEVICE_NAME_BUFFER_SIZE] = { 0 };
+
+        DYNCALL(nvmlDeviceGetGpuInstanceId)(mig, &gi);
+        DYNCALL(nvmlDeviceGetComputeInstanceId)(mig, &ci);
+
+        /* MIG device names end with their profile (e.g. "... MIG 3g.20gb") */
+        const char *profile = NULL;
+        if (DYNCALL(nvmlDeviceGetName)(mig, name, NVML_DEVICE_NAME_BUFFER_SIZE) == NVML_SUCCESS)
+            profile = strstr(name, "MIG ");
+
+        snprintf(dev->partition, PCI_STR_MAX - 1, "%s%sgi%u.ci%u", (profile != NULL) ? profile + 4 : "",
+                                                                   (profile != NULL) ? ":" : "", gi, ci);
+    }
+
+    nvml_devices_count++;
+    return 0;
+}
+
+/* Append a GPU, or all its MIG instances when MIG is enabled */
+static int nvml_add_gpu(nvmlDevice_t device)
+{
+    unsigned int current_mode, pending_mode, max_mig = 0;
+
+    if ((DYNCALL(nvmlDeviceGetMigMode)(device, &current_mode, &pending_mode) != NVML_SUCCESS) ||
+        (current_mode != NVML_DEVICE_MIG_ENABLE) ||
+        (DYNCALL(nvmlDeviceGetMaxMigDeviceCount)(device, &max_mig) != NVML_SUCCESS))
+        return nvml_add_device(device, NULL);
+
+    for (unsigned int i = 0; i < max_mig; i++)
+    {
+        nvmlDevice_t mig;
+
+        /* Unused MIG slots are not an error */
+        if (DYNCALL(nvmlDeviceGetMigDeviceHandleByIndex)(device, i, &mig) != NVML_SUCCESS)
+            continue;
+
+        if (nvml_add_device(device, mig) != 0)
+            return -1;
+    }
+
     return 0;
 }
 
 /**
- * Retrieve how many AMD devices are available from this context
+ * Append a device identified as CUDA does in CUDA_VISIBLE_DEVICES: index,
+ * GPU UUID (GPU-...) or MIG instance UUID (MIG-...).
  *
- * @return                   Quantity of devices found or -1
+ * @param   id[in]        Device identifier
+ * @return                Success: 0, Error: -1
  */
-int hpcat_accel_count(void)
+static int nvml_add_visible(const char *id)
 {
-    unsigned int dev_count = 0;
-    if (nvml_init() != 0)
+    nvmlDevice_t device, parent;
+
+    if (strncmp(id, "MIG-", 4) == 0)
+    {
+        if ((DYNCALL(nvmlDeviceGetHandleByUUID)(id, &device) != NVML_SUCCESS) ||
+            (DYNCALL(nvmlDeviceGetDeviceHandleFromMigDeviceHandle)(device, &parent) != NVML_SUCCESS))
+            return -1;
+
+        return nvml_add_device(parent, device);
+    }
+
+    if (strncmp(id, "GPU-", 4) == 0)
+    {
+        if (DYNCALL(nvmlDeviceGetHandleByUUID)(id, &device) != NVML_SUCCESS)
+            return -1;
+
+        return nvml_add_gpu(device);
+    }
+
+    hwloc_bitmap_t bitmap = hwloc_bitmap_alloc();
+    if (bitmap == NULL)
         return -1;
 
-    return (nvmlDeviceGetCount(&dev_count) == NVML_SUCCESS) ? (int)dev_count : -1;
+    int ret = strlist_to_bitmap(bitmap, id), index;
+    hwloc_bitmap_foreach_begin(index, bitmap)
+        if ((ret == 0) && (DYNCALL(nvmlDeviceGetHandleByIndex)(index, &device) == NVML_SUCCESS))
+            ret = nvml_add_gpu(device);
+        else
+            ret = -1;
+    hwloc_bitmap_foreach_end();
+
+    hwloc_bitmap_free(bitmap);
+    return ret;
 }
 
-static int get_device_id_array(int *ids, int *dev_count)
+static int nvml_init(void)
 {
-    int count = 0;
+    if (nvml_is_init)
+        return 0;
+
+    if (DYNCALL(nvmlInit)() != NVML_SUCCESS)
+        return -1;
 
     char *visible_env = getenv("CUDA_VISIBLE_DEVICES");
     if (visible_env == NULL)
     {
-        count = hpcat_accel_count();
-        for (int i = 0; i < count; i++)
-            ids[i] = i;
-    }
-    else
-    {
-        hwloc_bitmap_t bitmap = hwloc_bitmap_alloc();
-        if (bitmap == NULL)
-        {
-            printf("Failed to allocate bitmap\n");
+        unsigned int dev_count = 0;
+        if (DYNCALL(nvmlDeviceGetCount)(&dev_count) != NVML_SUCCESS)
             return -1;
-        }
 
-        if (strlist_to_bitmap(bitmap, visible_env) != 0)
+        for (unsigned int i = 0; i < dev_count; i++)
         {
-            printf("Failed to convert string list to bitmap\n");
-            return -1;
+            nvmlDevice_t device;
+            if ((DYNCALL(nvmlDeviceGetHandleByIndex)(i, &device) != NVML_SUCCESS) ||
+                (nvml_add_gpu(device) != 0))
+                return -1;
         }
-
-        count = hwloc_bitmap_weight(bitmap);
-        if (count > MAX_DEVICES)
-        {
-            printf("Device count is larger than the upper limit\n");
+    }
+    else
+    {
+        char *list = strdup(visible_env), *saveptr = NULL;
+        if (list == NULL)
             return -1;
-        }
-
-        ids[0] = hwloc_bitmap_first(bitmap);
 
-        for (int i = 1; i < count; i++)
-            ids[i] = hwloc_bitmap_next(bitmap, ids[i - 1]);
+        /* As CUDA does, devices following an invalid identifier are ignored */
+        for (char *token = strtok_r(list, ",", &saveptr); token != NULL;
+             token = strtok_r(NULL, ",", &saveptr))
+            if (nvml_add_visible(token) != 0)
+                break;
 
-        hwloc_bitmap_free(bitmap);
+        free(list);
     }
 
-    *dev_count = count;
+    nvml_is_init = true;
     return 0;
 }
 
+/**
+ * Retrieve how many NVIDIA devices (or MIG instances) are available from
+ * this context
+ *
+ * @return                   Quantity of devices found or -1
+ */
+int hpcat_accel_count(void)
+{
+    return (nvml_init() == 0) ? nvml_devices_count : -1;
+}
+
 /**
  *  Format a list (comma separated) of the PCIe addresses of all
  *  accelerators found.
@@ -114,14 +237,7 @@ static int get_device_id_array(int *ids, int *dev_count)
  */
 int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
 {
-    int ids[MAX_DEVICES] = {0};
-    int dev_count = 0;
-
-    /* List of devices */
-    int ret = get_device_id_array(ids, &dev_count);
-    if (ret != 0)
-        return -1;
-
+    const int dev_count = hpcat_accel_count();
     if (dev_count <= 0)
         return -1;
 
@@ -131,24 +247,8 @@ int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
     {
         char pci[PCI_STR_MAX] = { 0 };
 
-        nvmlDevice_t device;
-        nvmlPciInfo_t pci_info;
-
-        nvmlReturn_t res = nvmlDeviceGetHandleByIndex(ids[i], &device);
-        if (NVML_SUCCESS != res)
-        {
-            printf("Failed to get handle for device %u: %s\n", ids[i], nvmlErrorString(res));
-            return -1;
-        }
-
-        res = nvmlDeviceGetPciInfo(device, &pci_info);
-        if (NVML_SUCCESS != res) {
-            printf("Failed to get PCI info for device %u: %s\n", ids[i], nvmlErrorString(res));
-            return -1;
-        }
-
         snprintf(pci, PCI_STR_MAX - 1, "%s[%01x:%02x]", (buff[0] == '\0') ? "" : ",",
-                                                        pci_info.domain, pci_info.bus);
+                                                        nvml_devices[i].domain, nvml_devices[i].bus);
         strncat(buff, pci, max_size);
         max_size -= strlen(pci);
         if (max_size <= 0)
@@ -158,6 +258,45 @@ int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
     return 0;
 }
 
+/**
+ *  Format a list (comma separated) of the MIG instances of all accelerators
+ *  found. Full GPUs are reported as "-".
+ *
+ * @param   buff[out]          Output buffer for the list of partitions
+ * @param   max_buff_size[in]  Size of the buffer
+ * @return                     Success: 0, Error: -1
+ */
+int hpcat_accel_partition_list_str(char *buff, const int max_buff_size)
+{
+    const int dev_count = hpcat_accel_count();
+    if (dev_count <= 0)
+        return -1;
+
+    bool has_partition = false;
+    for (int i = 0; i < dev_count; i++)
+        has_partition |= (nvml_devices[i].partition[0] != '\0');
+
+    /* Nothing to report without MIG */
+    if (!has_partition)
+        return 0;
+
+    int max_size = max_buff_size - 1;
+
+    for (int i = 0; i < dev_count; i++)
+    {
+        char partition[PCI_STR_MAX + 1] = { 0 };
+
+        snprintf(partition, PCI_STR_MAX, "%s%s", (i == 0) ? "" : ",",
+                 (nvml_devices[i].partition[0] != '\0') ? nvml_devices[i].partition : "-");
+        strncat(buff, partition, max_size);
+        max_size -= strlen(partition);
+        if (max_size <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 /**
  * Retrive a list of visible devices in a bitmap
  *
@@ -166,15 +305,13 @@ int hpcat_accel_pciaddr_list_str(char *buff, const int max_buff_size)
  */
 int hpcat_accel_visible_bitmap(hwloc_bitmap_t bitmap)
 {
-    char *visible_env = getenv("CUDA_VISIBLE_DEVICES");
+    if (nvml_init() != 0)
+        return -1;
 
-    if (visible_env == NULL)
-    {
-        set_first_bits_bitmap(bitmap, hpcat_accel_count());
-        return 0;
-    }
-    else
-        return strlist_to_bitmap(bitmap, visible_env);
+    for (int i = 0; i < nvml_devices_count; i++)
+        hwloc_bitmap_set(bitmap, nvml_devices[i].index);
+
+    return 0;
 }
 
 /**
@@ -184,28 +321,10 @@ int hpcat_accel_visible_bitmap(hwloc_bitmap_t bitmap)
  */
 int hpcat_accel_numa_first(void)
 {
-    const int dev_count = hpcat_accel_count();
-    if (dev_count <= 0)
+    if (hpcat_accel_count() <= 0)
         return -1;
 
-    nvmlDevice_t device;
-    nvmlPciInfo_t pci;
-
-    nvmlReturn_t res = nvmlDeviceGetHandleByIndex(ids[0], &device);
-    if (NVML_SUCCESS != res)
-    {
-        printf("Failed to get handle for device 0: %s\n", nvmlErrorString(res));
-        return -1;
-    }
-
-    res = nvmlDeviceGetPciInfo(device, &pci);
-    if (NVML_SUCCESS != res)
-    {
-        printf("Failed to get PCI info for device 0: %s\n", nvmlErrorString(res));
-        return -1;
-    }
-
-    return get_device_numa_affinity(pci.domain, pci.bus);
+    return get_device_numa_affinity(nvml_devices[0].domain, nvml_devices[0].bus);
 }
 
 /**
@@ -216,37 +335,13 @@ int hpcat_accel_numa_first(void)
  */
 int hpcat_accel_numa_bitmap(hwloc_bitmap_t numa_affinity)
 {
-    int ids[MAX_DEVICES] = {0};
-    int dev_count = 0;
-
-    /* List of devices */
-    int ret = get_device_id_array(ids, &dev_count);
-    if (ret != 0)
-        return -1;
-
+    const int dev_count = hpcat_accel_count();
     if (dev_count <= 0)
         return -1;
 
     for (int i = 0; i < dev_count; i++)
     {
-        nvmlDevice_t device;
-        nvmlPciInfo_t pci;
-
-        nvmlReturn_t res = nvmlDeviceGetHandleByIndex(ids[i], &device);
-        if (NVML_SUCCESS != res)
-        {
-            printf("Failed to get handle for device %u: %s\n", ids[i], nvmlErrorString(res));
-            return -1;
-        }
-
-        res = nvmlDeviceGetPciInfo(device, &pci);
-        if (NVML_SUCCESS != res)
-        {
-            printf("Failed to get PCI info for device %u: %s\n", ids[i], nvmlErrorString(res));
-            return -1;
-        }
-
-        const int numa_node = get_device_numa_affinity(pci.domain, pci.bus);
+        const int numa_node = get_device_numa_affinity(nvml_devices[i].domain, nvml_devices[i].bus);
         if (numa_node == -1)
             return -1;
 
@@ -255,3 +350,23 @@ int hpcat_accel_numa_bitmap(hwloc_bitmap_t numa_affinity)
 
     return 0;
 }
+
+#ifdef HPCAT_STATIC_BACKEND
+static int nvml_runtime_load(void *lib_handle)
+{
+    NVML_SYMBOLS(DYNLOAD_RESOLVE)
+    return 0;
+}
+
+const AccelBackend HPCAT_STATIC_BACKEND =
+{
+    .name               = "libhpcatnvml.so (built-in)",
+    .runtime_load       = nvml_runtime_load,
+    .count              = hpcat_accel_count,
+    .pciaddr_list_str   = hpcat_accel_pciaddr_list_str,
+    .numa_bitmap        = hpcat_accel_numa_bitmap,
+    .visible_bitmap     = hpcat_accel_visible_bitmap,
+    .numa_first         = hpcat_accel_numa_first,
+    .partition_list_str = hpcat_accel_partition_list_str,
+};
+#endif
@@ -0,0 +1,208 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* outbuf.c: Output arena written with few large writes.
+*
+* The whole output is formatted in a growable buffer and written once when
+* done. Very large outputs are written in multiples of OUT_CHUNK_SIZE as soon
+* as OUT_FLUSH_SIZE bytes are pending, so that memory stays bounded and the
+* writes stay aligned on the stripes of parallel filesystems. Without file
+* descriptor, the output stays in memory for the caller to write it (MPI-IO).
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+#include "common.h"
+
+static void out_reserve(OutBuffer *out, const size_t len)
+{
+    if (out->size + len < out->capacity)
+        return;
+
+    size_t capacity = (out->capacity == 0) ? OUT_CHUNK_SIZE : out->capacity;
+    while (out->size + len >= capacity)
+        capacity *= 2;
+
+    char *data = realloc(out->data, capacity);
+    if (data == NULL)
+        FATAL("Error: unable to allocate the output buffer. Exiting.\n");
+
+    out->data = data;
+    out->capacity = capacity;
+}
+
+static void out_write_fd(OutBuffer *out, const size_t len)
+{
+    size_t written = 0;
+
+    /* Anything left by stdio must come first */
+    fflush(stdout);
+
+    while (written < len)
+    {
+        const ssize_t ret = write(out->fd, out->data + written, len - written);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            FATAL("Error: unable to write the output: %s. Exiting.\n", strerror(errno));
+        }
+
+        written += ret;
+    }
+
+    out->size -= len;
+    memmove(out->data, out->data + len, out->size);
+}
+
+/**
+ * Initialize an empty output buffer
+ *
+ * @param   out[out]      Output buffer
+ * @param   fd[in]        File descriptor the output is written to, -1 to keep it in memory
+ */
+void hpcat_out_init(OutBuffer *out, const int fd)
+{
+    out->data = NULL;
+    out->size = 0;
+    out->capacity = 0;
+    out->fd = fd;
+}
+
+/**
+ * Append a string to the output, whole chunks are written if too many bytes are pending
+ *
+ * @param   out[inout]    Output buffer
+ * @param   str[in]       String to append
+ * @param   len[in]       Length of the string
+ */
+void hpcat_out_write(OutBuffer *out, const char *str, const size_t len)
+{
+    out_reserve(out, len);
+    memcpy(out->data + out->size, str, len);
+    out->size += len;
+
+    if ((out->fd >= 0) && (out->size >= OUT_FLUSH_SIZE))
+        out_write_fd(out, out->size - out->size % OUT_CHUNK_SIZE);
+}
+
+/**
+ * Append formatted text to the output (printf-like)
+ *
+ * @param   out[inout]    Output buffer
+ * @param   format[in]    Format string
+ */
+void hpcat_out_printf(OutBuffer *out, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(out->data + out->size, out->capacity - out->size, format, args);
+    va_end(args);
+
+    if (len < 0)
+        FATAL("Error: unable to format the output. Exiting.\n");
+
+    /* Not enough room, format again once the buffer has grown */
+    if (out->size + len >= out->capacity)
+    {
+        out_reserve(out, len);
+        va_start(args, format);
+        vsnprintf(out->data + out->size, out->capacity - out->size, format, args);
+        va_end(args);
+    }
+
+    out->size += len;
+
+    if ((out->fd >= 0) && (out->size >= OUT_FLUSH_SIZE))
+        out_write_fd(out, out->size - out->size % OUT_CHUNK_SIZE);
+}
+
+static int compare_ranks(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/**
+ * Append a compressed list of ranks (0-3,8,10-12), the ranges above OUT_RANGES_MAX
+ * are only counted
+ *
+ * @param   out[inout]    Output buffer
+ * @param   ranks[inout]  Ranks, sorted in place
+ * @param   count[in]     Number of ranks
+ */
+void hpcat_out_ranks(OutBuffer *out, int *ranks, const int count)
+{
+    int num_ranges = 0;
+
+    qsort(ranks, count, sizeof(int), compare_ranks);
+
+    for (int i = 0; i < count; i++)
+    {
+        int last = i;
+        while ((last + 1 < count) && (ranks[last + 1] == ranks[last] + 1))
+            last++;
+
+        if (num_ranges == OUT_RANGES_MAX)
+        {
+            hpcat_out_printf(out, ",... (%d more)", count - i);
+            break;
+        }
+
+        hpcat_out_printf(out, "%s%d", (num_ranges > 0) ? "," : "", ranks[i]);
+        if (last > i)
+            hpcat_out_printf(out, "-%d", ranks[last]);
+
+        num_ranges++;
+        i = last;
+    }
+}
+
+/**
+ * Write all pending output
+ *
+ * @param   out[inout]    Output buffer
+ */
+void hpcat_out_flush(OutBuffer *out)
+{
+    if (out->size > 0)
+        out_write_fd(out, out->size);
+}
+
+/**
+ * Release the output buffer, pending output is discarded
+ *
+ * @param   out[inout]    Output buffer
+ */
+void hpcat_out_free(OutBuffer *out)
+{
+    free(out->data);
+    hpcat_out_init(out, out->fd);
+}
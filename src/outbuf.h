@@ -0,0 +1,44 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* outbuf.h: Output arena written with few large writes
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#ifndef HPCAT_OUTBUF_H
+#define HPCAT_OUTBUF_H
+
+#include "hpcat.h"
+
+#define OUT_CHUNK_SIZE  (1 << 20)             /* Write granularity (Lustre stripe size) */
+#define OUT_FLUSH_SIZE  (8 * OUT_CHUNK_SIZE)  /* Buffered bytes triggering a partial flush */
+#define OUT_RANGES_MAX  32                    /* Ranges of a rank list, the others are counted */
+
+void hpcat_out_init(OutBuffer *out, const int fd);
+void hpcat_out_write(OutBuffer *out, const char *str, const size_t len);
+void hpcat_out_printf(OutBuffer *out, const char *format, ...);
+void hpcat_out_ranks(OutBuffer *out, int *ranks, const int count);
+void hpcat_out_flush(OutBuffer *out);
+void hpcat_out_free(OutBuffer *out);
+
+#endif /* HPCAT_OUTBUF_H */
@@ -34,9 +34,11 @@
 #include "hwloc.h"
 #include "fort.h"
 #include "output.h"
+#include "outbuf.h"
 #include "common.h"
 #include "settings.h"
 #include "hint.h"
+#include "pcie.h"
 
 #define STR_MAX      4096
 #define INT_STR_MAX    10
@@ -49,9 +51,29 @@
 #define OMP_COL    1
 #define CPU_COL    3
 #define ACCEL_COL  3
+#define PART_COL   1
 #define NIC_COL    2
 #define FABRIC_COL 1
 
+static const char * const phase_str[] =
+{
+    [PHASE_MPI_INIT]    = "mpi_init",
+    [PHASE_NODE_SPLIT]  = "node_split",
+    [PHASE_TOPOLOGY]    = "topology",
+    [PHASE_NODE_PROBE]  = "node_probe",
+    [PHASE_AFFINITY]    = "affinity",
+    [PHASE_FABRIC]      = "fabric",
+    [PHASE_ACCEL_MOCK]  = "accel_mock",
+    [PHASE_ACCEL_HIP]   = "accel_hip",
+    [PHASE_ACCEL_NVML]  = "accel_nvml",
+    [PHASE_ACCEL_ZE]    = "accel_ze",
+    [PHASE_ACCEL_SYSFS] = "accel_sysfs",
+    [PHASE_LOCALITY]    = "locality",
+    [PHASE_HINTS]       = "hints",
+    [PHASE_GATHER]      = "gather",
+    [PHASE_RENDER]      = "render",
+};
+
 ft_table_t *table = NULL;
 size_t num_columns = 0;
 size_t num_rows = 0;
@@ -62,7 +84,8 @@ static void stdout_header(Hpcat *handle)
 {
     HpcatSettings_t *settings = &handle->settings;
 
-    printf("%s\n", handle->mpi_version);
+    hpcat_out_printf(&handle->out, "%s\n", (handle->prediction[0] != '\0') ? handle->prediction
+                                                                          : handle->mpi_version);
 
     /* Configuring the header */
     if (settings->color_type != NOCOLOR)
@@ -118,10 +141,13 @@ static void stdout_titles(Hpcat *handle)
     HpcatSettings_t *settings = &handle->settings;
     char row_str[STR_MAX];
 
+    const char *accel_title = (settings->enable_partition ? "|ACCELERATORS|||" : "|ACCELERATORS||");
+    const char *accel_subtitle = (settings->enable_partition ? "|ID|PCIE ADDR.|NUMA|PARTITION" : "|ID|PCIE ADDR.|NUMA");
+
     /* First title row */
     sprintf(row_str, "%sHOST|MPI|%sCPU||%s%s", (settings->enable_fabric ? "FABRIC|" : "" ),
                                                (settings->enable_omp ? "OMP|" : "" ),
-                                               (settings->enable_accel ? "|ACCELERATORS||" : ""),
+                                               (settings->enable_accel ? accel_title : ""),
                                                (settings->enable_nic ? "|NETWORK|" : ""));
     ft_printf_ln(table, row_str);
 
@@ -140,7 +166,7 @@ static void stdout_titles(Hpcat *handle)
     if (settings->enable_omp)
         ft_set_cell_prop(table, num_rows, start_omp, FT_CPROP_TEXT_ALIGN, FT_ALIGNED_RIGHT);
     if (settings->enable_accel)
-        ft_set_cell_span(table, num_rows, start_accel, 3);
+        ft_set_cell_span(table, num_rows, start_accel, ACCEL_COL + (settings->enable_partition ? PART_COL : 0));
     if (settings->enable_nic)
         ft_set_cell_span(table, num_rows, start_nic, 2);
 
@@ -150,7 +176,7 @@ static void stdout_titles(Hpcat *handle)
     sprintf(row_str, "%s(NODE)|RANK|%sLOGICAL PROC|PHYSICAL CORE|NUMA%s%s",
                                          (settings->enable_fabric ? "GROUP ID|" : "" ),
                                          (settings->enable_omp ? "ID|" : "" ),
-                                         (settings->enable_accel ? "|ID|PCIE ADDR.|NUMA" : ""),
+                                         (settings->enable_accel ? accel_subtitle : ""),
                                          (settings->enable_nic ? "|INTERFACE|NUMA" : ""));
 
     ft_printf_ln(table, row_str);
@@ -197,8 +223,8 @@ static void stdout_task(Hpcat *handle, Task *task)
     if (bitmap == NULL)
         FATAL("Error: Unable to allocate temporary bitmap. Exiting.\n");
 
-    bitmap_to_str(hw_thread_str, (Bitmap*)&task->affinity.hw_thread_affinity, bitmap);
-    bitmap_to_str(core_str, (Bitmap*)&task->affinity.core_affinity, bitmap);
+    bitmap_to_str(hw_thread_str, &task->affinity.hw_thread_affinity, bitmap);
+    bitmap_to_str(core_str, &task->affinity.core_affinity, bitmap);
     bitmap_to_str(numa_str, &task->affinity.numa_affinity, bitmap);
 
     if (task->accel.num_accel > 0)
@@ -207,15 +233,15 @@ static void stdout_task(Hpcat *handle, Task *task)
         bitmap_to_str(accel_visible_str, &task->accel.visible_devices, bitmap);
     }
 
-    hwloc_bitmap_free(bitmap);
-
     if (task->nic.num_nic > 0)
-        sprintf(nic_numa_str, "%d", task->nic.numa_affinity);
+        bitmap_to_str(nic_numa_str, &task->nic.numa_affinity, bitmap);
+
+    hwloc_bitmap_free(bitmap);
 
     if (settings->enable_hints)
         hpcat_hint_task_superscript(hint_str, task->detected_hints);
 
-    sprintf(row_str, "%s%s|%d|%s%s|%s|%s%s%s%s%s%s%s%s%s%s%s",
+    sprintf(row_str, "%s%s|%d|%s%s|%s|%s%s%s%s%s%s%s%s%s%s%s%s%s",
                                      (settings->enable_fabric ? "|" : ""),
                                      (settings->enable_hints ? hint_str : ""),
                                      task->id,
@@ -227,6 +253,8 @@ static void stdout_task(Hpcat *handle, Task *task)
                                      (settings->enable_accel ? task->accel.pciaddr : ""),
                                      (settings->enable_accel ? "|" : ""),
                                      (settings->enable_accel ? accel_numa_str : ""),
+                                     (settings->enable_accel && settings->enable_partition ? "|" : ""),
+                                     (settings->enable_accel && settings->enable_partition ? task->accel.partition : ""),
                                      (settings->enable_nic ? "|" : ""),
                                      (settings->enable_nic ? task->nic.name : ""),
                                      (settings->enable_nic ? "|" : ""),
@@ -257,8 +285,8 @@ static void stdout_omp(Hpcat *handle, Task *task)
     {
         Thread *thread = &task->threads[i];
 
-        bitmap_to_str(hw_thread_str, (Bitmap*)&thread->affinity.hw_thread_affinity, bitmap);
-        bitmap_to_str(core_str, (Bitmap*)&thread->affinity.core_affinity, bitmap);
+        bitmap_to_str(hw_thread_str, &thread->affinity.hw_thread_affinity, bitmap);
+        bitmap_to_str(core_str, &thread->affinity.core_affinity, bitmap);
         bitmap_to_str(numa_str, &thread->affinity.numa_affinity, bitmap);
 
         sprintf(row_str, "%s||%d|%s|%s|%s", (settings->enable_fabric ? "|" : ""),
@@ -272,9 +300,9 @@ static void stdout_omp(Hpcat *handle, Task *task)
 }
 
 /**
- * Output data in human readble format (stdout)
+ * Output data in human readble format (appended to the output buffer)
  *
- * @param   handle[in]          Hpcat handle
+ * @param   handle[inout]       Hpcat handle
  */
 void hpcat_display_stdout(Hpcat *handle, Task *task)
 {
@@ -295,7 +323,7 @@ void hpcat_display_stdout(Hpcat *handle, Task *task)
         if (settings->enable_omp)
             num_columns += OMP_COL;
         if (settings->enable_accel)
-            num_columns += ACCEL_COL;
+            num_columns += ACCEL_COL + (settings->enable_partition ? PART_COL : 0);
         if (settings->enable_nic)
             num_columns += NIC_COL;
 
@@ -305,7 +333,8 @@ void hpcat_display_stdout(Hpcat *handle, Task *task)
         start_omp = start_mpi + MPI_COL;
         start_cpu = start_omp + (settings->enable_omp ? OMP_COL : 0);
         start_accel = start_cpu + CPU_COL;
-        start_nic = start_accel + (settings->enable_accel ? ACCEL_COL : 0);
+        start_nic = start_accel + (settings->enable_accel ? ACCEL_COL : 0)
+                                + (settings->enable_accel && settings->enable_partition ? PART_COL : 0);
 
         if (settings->color_type != NOCOLOR)
         {
@@ -365,59 +394,76 @@ void hpcat_display_stdout(Hpcat *handle, Task *task)
         }
 
         /* Dump the table */
-        printf("%s\n", ft_to_string(table));
+        const char *table_str = ft_to_string(table);
+        hpcat_out_write(&handle->out, table_str, strlen(table_str));
+        hpcat_out_write(&handle->out, "\n", 1);
         ft_destroy_table(table);
     }
 }
 
-/**
- * Output data in yaml format (stdout)
- *
- * @param   handle[in]          Hpcat handle
- */
-void hpcat_display_yaml(Hpcat *handle, Task *task)
+static void yaml_locality(OutBuffer *out, IoLocality *locality, hwloc_bitmap_t bitmap)
+{
+    char cores_str[STR_MAX], l3_str[STR_MAX];
+
+    if (locality->cores.num_ulongs == 0)
+        return;
+
+    bitmap_to_str(cores_str, &locality->cores, bitmap);
+    bitmap_to_str(l3_str, &locality->l3, bitmap);
+    hpcat_out_printf(out, "%12sclosest_cores: \"%s\"\n", " ", cores_str);
+    hpcat_out_printf(out, "%12sclosest_l3: \"%s\"\n", " ", l3_str);
+}
+
+static void yaml_header(Hpcat *handle)
+{
+    hpcat_out_printf(&handle->out, "mpiversion: \"%s\"\n", handle->mpi_version);
+    if (handle->prediction[0] != '\0')
+        hpcat_out_printf(&handle->out, "prediction: \"%s\"\n", handle->prediction);
+    hpcat_out_printf(&handle->out, "nodes:\n");
+}
+
+static void yaml_task(Hpcat *handle, Task *task)
 {
     HpcatSettings_t *settings = &handle->settings;
+    OutBuffer *out = &handle->out;
     char hw_thread_str[STR_MAX], core_str[STR_MAX], numa_str[STR_MAX];
 
     hwloc_bitmap_t bitmap = hwloc_bitmap_alloc();
     if (bitmap == NULL)
         FATAL("Error: Unable to allocate temporary bitmap. Exiting.\n");
 
-    bitmap_to_str(hw_thread_str, (Bitmap*)&task->affinity.hw_thread_affinity, bitmap);
-    bitmap_to_str(core_str, (Bitmap*)&task->affinity.core_affinity, bitmap);
+    bitmap_to_str(hw_thread_str, &task->affinity.hw_thread_affinity, bitmap);
+    bitmap_to_str(core_str, &task->affinity.core_affinity, bitmap);
     bitmap_to_str(numa_str, &task->affinity.numa_affinity, bitmap);
 
-    if (task->is_first_rank)
-    {
-        printf("mpiversion: \"%s\"\n", handle->mpi_version);
-        printf("nodes:\n");
-    }
-
     /* Node level */
     if (task->is_first_node_rank)
     {
-        printf("%2s- name: \"%s\"\n", " ", task->hostname);
+        hpcat_out_printf(out, "%2s- name: \"%s\"\n", " ", task->hostname);
 
         if (settings->enable_fabric)
-            printf("%4sfabric_group_id: %d\n", " ", task->fabric_group_id);
+            hpcat_out_printf(out, "%4sfabric_group_id: %d\n", " ", task->fabric_group_id);
 
-        printf("%4smpi:\n", " ");
+        hpcat_out_printf(out, "%4smpi:\n", " ");
     }
 
     /* Task level */
-    printf("%6s- rank: %d\n", " ", task->id);
-    printf("%8slogical_proc: \"%s\"\n", " ", hw_thread_str);
-    printf("%8sphysical_core: \"%s\"\n", " ", core_str);
-    printf("%8snuma: \"%s\"\n", " ", numa_str);
+    hpcat_out_printf(out, "%6s- rank: %d\n", " ", task->id);
+    hpcat_out_printf(out, "%8slogical_proc: \"%s\"\n", " ", hw_thread_str);
+    hpcat_out_printf(out, "%8sphysical_core: \"%s\"\n", " ", core_str);
+    hpcat_out_printf(out, "%8snuma: \"%s\"\n", " ", numa_str);
 
     if (task->nic.num_nic > 0)
     {
         char nic_numa_str[STR_MAX] = { 0 };
-        sprintf(nic_numa_str, "%d", task->nic.numa_affinity);
-        printf("%8snetwork:\n", " ");
-        printf("%10s- interface: \"%s\"\n", " ", task->nic.name);
-        printf("%12snuma: \"%s\"\n", " ", nic_numa_str);
+        bitmap_to_str(nic_numa_str, &task->nic.numa_affinity, bitmap);
+        hpcat_out_printf(out, "%8snetwork:\n", " ");
+        hpcat_out_printf(out, "%10s- interface: \"%s\"\n", " ", task->nic.name);
+        hpcat_out_printf(out, "%12snuma: \"%s\"\n", " ", nic_numa_str);
+        if (task->nic.gpu_path != PCIE_PATH_UNKNOWN)
+            hpcat_out_printf(out, "%12sgpu_path: \"%s\"\n", " ", hpcat_pcie_path_str(task->nic.gpu_path));
+
+        yaml_locality(out, &task->nic.locality, bitmap);
     }
 
     if (task->accel.num_accel > 0)
@@ -426,48 +472,509 @@ void hpcat_display_yaml(Hpcat *handle, Task *task)
         char accel_visible_str[STR_MAX] = { 0 };
         bitmap_to_str(accel_numa_str, &task->accel.numa_affinity, bitmap);
         bitmap_to_str(accel_visible_str, &task->accel.visible_devices, bitmap);
-        printf("%8saccelerators:\n", " ");
-        printf("%10s- visible: \"%s\"\n", " ", accel_visible_str);
-        printf("%12spci: \"%s\"\n", " ", task->accel.pciaddr);
-        printf("%12snuma: \"%s\"\n", " ", accel_numa_str);
+        hpcat_out_printf(out, "%8saccelerators:\n", " ");
+        hpcat_out_printf(out, "%10s- visible: \"%s\"\n", " ", accel_visible_str);
+        hpcat_out_printf(out, "%12spci: \"%s\"\n", " ", task->accel.pciaddr);
+        hpcat_out_printf(out, "%12snuma: \"%s\"\n", " ", accel_numa_str);
+
+        if (task->accel.partition[0] != '\0')
+            hpcat_out_printf(out, "%12spartition: \"%s\"\n", " ", task->accel.partition);
+
+        yaml_locality(out, &task->accel.locality, bitmap);
     }
 
     /* OMP thread level */
     if (task->num_threads > 1 && settings->enable_omp)
     {
-        printf("%8somp:\n", " ");
+        hpcat_out_printf(out, "%8somp:\n", " ");
         for (int i = 0; i < task->num_threads; i++)
         {
             Thread *thread = &task->threads[i];
-            bitmap_to_str(hw_thread_str, (Bitmap*)&task->affinity.hw_thread_affinity, bitmap);
-            bitmap_to_str(core_str, (Bitmap*)&task->affinity.core_affinity, bitmap);
-            bitmap_to_str(numa_str, &task->affinity.numa_affinity, bitmap);
-
-            printf("%10s- thread: %d\n", " ", thread->id);
-            printf("%12slogical_proc: \"%s\"\n", " ", hw_thread_str);
-            printf("%12sphysical_core: \"%s\"\n", " ", core_str);
-            printf("%12snuma: \"%s\"\n", " ", numa_str);
+            bitmap_to_str(hw_thread_str, &thread->affinity.hw_thread_affinity, bitmap);
+            bitmap_to_str(core_str, &thread->affinity.core_affinity, bitmap);
+            bitmap_to_str(numa_str, &thread->affinity.numa_affinity, bitmap);
+
+            hpcat_out_printf(out, "%10s- thread: %d\n", " ", thread->id);
+            hpcat_out_printf(out, "%12slogical_proc: \"%s\"\n", " ", hw_thread_str);
+            hpcat_out_printf(out, "%12sphysical_core: \"%s\"\n", " ", core_str);
+            hpcat_out_printf(out, "%12snuma: \"%s\"\n", " ", numa_str);
         }
     }
 
+    hwloc_bitmap_free(bitmap);
+}
+
+static void yaml_totals(Hpcat *handle)
+{
+    HpcatSettings_t *settings = &handle->settings;
+    OutBuffer *out = &handle->out;
+
+    if (settings->enable_fabric)
+        hpcat_out_printf(out, "total_fabric_groups: %d\n", handle->num_fabric_groups);
+
+    hpcat_out_printf(out, "total_nodes: %d\n", handle->num_nodes);
+    hpcat_out_printf(out, "total_mpi_ranks: %d\n", handle->num_tasks);
+
+    if (settings->enable_omp)
+        hpcat_out_printf(out, "total_omp_threads: %d\n", handle->num_omp_threads);
+
+    if (settings->enable_hints)
+    {
+        char hints_str[STR_MAX];
+        hpcat_hint_format(hints_str, handle->detected_hints);
+        hpcat_out_printf(out, "hints: \"%s\"\n", hints_str);
+    }
+}
+
+/**
+ * Output data in yaml format (appended to the output buffer)
+ *
+ * @param   handle[inout]       Hpcat handle
+ */
+void hpcat_display_yaml(Hpcat *handle, Task *task)
+{
+    if (task->is_first_rank)
+        yaml_header(handle);
+
+    yaml_task(handle, task);
+
     if (task->is_last_rank)
+        yaml_totals(handle);
+}
+
+static void json_string(OutBuffer *out, const char *str)
+{
+    hpcat_out_write(out, "\"", 1);
+
+    for (const char *c = str; *c != '\0'; c++)
+    {
+        if ((*c == '"') || (*c == '\\'))
+            hpcat_out_printf(out, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            hpcat_out_printf(out, "\\u%04x", *c);
+        else
+            hpcat_out_write(out, c, 1);
+    }
+
+    hpcat_out_write(out, "\"", 1);
+}
+
+/* Comma separated lists (PCIe addresses, partitions, NIC names) are written as arrays of strings */
+static void json_string_list(OutBuffer *out, const char *list)
+{
+    char item[STR_MAX];
+    const char *pos = list;
+
+    hpcat_out_write(out, "[", 1);
+    while (*pos != '\0')
+    {
+        const int len = strcspn(pos, ",");
+
+        snprintf(item, STR_MAX, "%.*s", len, pos);
+        if (pos != list)
+            hpcat_out_write(out, ",", 1);
+        json_string(out, item);
+
+        pos += len;
+        if (*pos == ',')
+            pos++;
+    }
+    hpcat_out_write(out, "]", 1);
+}
+
+/* Bitmaps are written as arrays of indexes */
+static void json_bitmap(OutBuffer *out, const char *key, Bitmap *bitmap, hwloc_bitmap_t tmp)
+{
+    int index, count = 0;
+
+    hwloc_bitmap_zero(tmp);
+    hwloc_bitmap_from_ulongs(tmp, bitmap->num_ulongs, bitmap->ulongs);
+
+    hpcat_out_printf(out, ",\"%s\":[", key);
+    hwloc_bitmap_foreach_begin(index, tmp)
+        hpcat_out_printf(out, "%s%d", (count++ > 0) ? "," : "", index);
+    hwloc_bitmap_foreach_end();
+    hpcat_out_write(out, "]", 1);
+}
+
+static void json_hints(OutBuffer *out, const char detected_hints)
+{
+    int count = 0;
+
+    hpcat_out_printf(out, ",\"hints\":[");
+    for (int i = 0; i < HINT_MAX; i++)
+        if (hpcat_hint_is_set(detected_hints, i))
+            hpcat_out_printf(out, "%s\"%s\"", (count++ > 0) ? "," : "", hpcat_hint_code(i));
+    hpcat_out_write(out, "]", 1);
+}
+
+static void json_affinity(OutBuffer *out, Affinity *affinity, hwloc_bitmap_t tmp)
+{
+    json_bitmap(out, "logical_proc", &affinity->hw_thread_affinity, tmp);
+    json_bitmap(out, "physical_core", &affinity->core_affinity, tmp);
+    json_bitmap(out, "numa", &affinity->numa_affinity, tmp);
+}
+
+static void json_locality(OutBuffer *out, IoLocality *locality, hwloc_bitmap_t tmp)
+{
+    if (locality->cores.num_ulongs == 0)
+        return;
+
+    json_bitmap(out, "closest_cores", &locality->cores, tmp);
+    json_bitmap(out, "closest_l3", &locality->l3, tmp);
+}
+
+/* Fields of a rank, after its "rank" key */
+static void json_task(Hpcat *handle, Task *task, hwloc_bitmap_t tmp)
+{
+    OutBuffer *out = &handle->out;
+
+    json_affinity(out, &task->affinity, tmp);
+
+    if (task->nic.num_nic > 0)
+    {
+        hpcat_out_printf(out, ",\"network\":{\"interface\":");
+        json_string_list(out, task->nic.name);
+        json_bitmap(out, "numa", &task->nic.numa_affinity, tmp);
+        if (task->nic.gpu_path != PCIE_PATH_UNKNOWN)
+            hpcat_out_printf(out, ",\"gpu_path\":\"%s\"", hpcat_pcie_path_str(task->nic.gpu_path));
+        json_locality(out, &task->nic.locality, tmp);
+        hpcat_out_write(out, "}", 1);
+    }
+
+    if (task->accel.num_accel > 0)
+    {
+        hpcat_out_printf(out, ",\"accelerators\":{\"pci\":");
+        json_string_list(out, task->accel.pciaddr);
+        json_bitmap(out, "visible", &task->accel.visible_devices, tmp);
+        json_bitmap(out, "numa", &task->accel.numa_affinity, tmp);
+        if (task->accel.partition[0] != '\0')
+        {
+            hpcat_out_printf(out, ",\"partition\":");
+            json_string_list(out, task->accel.partition);
+        }
+        json_locality(out, &task->accel.locality, tmp);
+        hpcat_out_write(out, "}", 1);
+    }
+
+    if (handle->settings.enable_hints)
+        json_hints(out, task->detected_hints);
+}
+
+/* Totals of the job, after the last rank */
+static void json_totals(Hpcat *handle)
+{
+    HpcatSettings_t *settings = &handle->settings;
+    OutBuffer *out = &handle->out;
+
+    if (settings->enable_fabric)
+        hpcat_out_printf(out, ",\"total_fabric_groups\":%d", handle->num_fabric_groups);
+
+    hpcat_out_printf(out, ",\"total_nodes\":%d,\"total_mpi_ranks\":%d", handle->num_nodes, handle->num_tasks);
+
+    if (settings->enable_omp)
+        hpcat_out_printf(out, ",\"total_omp_threads\":%d", handle->num_omp_threads);
+
+    if (settings->enable_hints)
+        json_hints(out, handle->detected_hints);
+}
+
+/* Launch settings of a predicted placement (--predict), after the MPI version */
+static void json_prediction(Hpcat *handle)
+{
+    if (handle->prediction[0] == '\0')
+        return;
+
+    hpcat_out_printf(&handle->out, ",\"prediction\":");
+    json_string(&handle->out, handle->prediction);
+}
+
+static void json_header(Hpcat *handle)
+{
+    hpcat_out_printf(&handle->out, "{\"mpiversion\":");
+    json_string(&handle->out, handle->mpi_version);
+    json_prediction(handle);
+    hpcat_out_printf(&handle->out, ",\"nodes\":[");
+}
+
+static void json_record(Hpcat *handle, Task *task)
+{
+    HpcatSettings_t *settings = &handle->settings;
+    OutBuffer *out = &handle->out;
+
+    hwloc_bitmap_t bitmap = hwloc_bitmap_alloc();
+    if (bitmap == NULL)
+        FATAL("Error: Unable to allocate temporary bitmap. Exiting.\n");
+
+    /* Node level */
+    if (task->is_first_node_rank)
     {
+        hpcat_out_printf(out, "%s\n{\"name\":", task->is_first_rank ? "" : "]},");
+        json_string(out, task->hostname);
+
         if (settings->enable_fabric)
-            printf("total_fabric_groups: %d\n", handle->num_fabric_groups);
+            hpcat_out_printf(out, ",\"fabric_group_id\":%d", task->fabric_group_id);
 
-        printf("total_nodes: %d\n", handle->num_nodes);
-        printf("total_mpi_ranks: %d\n", handle->num_tasks);
+        hpcat_out_printf(out, ",\"mpi\":[");
+    }
+    else
+        hpcat_out_write(out, ",", 1);
 
-        if (settings->enable_omp)
-            printf("total_omp_threads: %d\n", handle->num_omp_threads);
+    /* Task level */
+    hpcat_out_printf(out, "\n{\"rank\":%d", task->id);
+    json_task(handle, task, bitmap);
+
+    /* OMP thread level */
+    if (task->num_threads > 1 && settings->enable_omp)
+    {
+        hpcat_out_printf(out, ",\"omp\":[");
+        for (int i = 0; i < task->num_threads; i++)
+        {
+            hpcat_out_printf(out, "%s{\"thread\":%d", (i > 0) ? "," : "", task->threads[i].id);
+            json_affinity(out, &task->threads[i].affinity, bitmap);
+            hpcat_out_write(out, "}", 1);
+        }
+        hpcat_out_write(out, "]", 1);
+    }
+
+    hpcat_out_write(out, "}", 1);
+
+    hwloc_bitmap_free(bitmap);
+}
 
-        if (settings->enable_hints)
+/* Close the node list, then totals */
+static void json_end(Hpcat *handle)
+{
+    hpcat_out_printf(&handle->out, "]}]");
+    json_totals(handle);
+}
+
+/**
+ * Output data as a JSON document nested per node like the YAML output (appended
+ * to the output buffer). The document is closed by hpcat_display_close().
+ *
+ * @param   handle[inout]       Hpcat handle
+ * @param   task[in]            Task record
+ */
+void hpcat_display_json(Hpcat *handle, Task *task)
+{
+    if (task->is_first_rank)
+        json_header(handle);
+
+    json_record(handle, task);
+
+    if (task->is_last_rank)
+        json_end(handle);
+}
+
+static void jsonl_record(Hpcat *handle, Task *task)
+{
+    HpcatSettings_t *settings = &handle->settings;
+    OutBuffer *out = &handle->out;
+    char node_str[STR_MAX] = { 0 };
+
+    hwloc_bitmap_t bitmap = hwloc_bitmap_alloc();
+    if (bitmap == NULL)
+        FATAL("Error: Unable to allocate temporary bitmap. Exiting.\n");
+
+    /* Node of each record */
+    if (settings->enable_fabric)
+        snprintf(node_str, STR_MAX - 1, ",\"fabric_group_id\":%d", task->fabric_group_id);
+
+    hpcat_out_printf(out, "{\"type\":\"rank\",\"rank\":%d,\"node\":", task->id);
+    json_string(out, task->hostname);
+    hpcat_out_printf(out, "%s", node_str);
+    json_task(handle, task, bitmap);
+    hpcat_out_printf(out, "}\n");
+
+    if (task->num_threads > 1 && settings->enable_omp)
+    {
+        for (int i = 0; i < task->num_threads; i++)
         {
-            char hints_str[STR_MAX];
-            hpcat_hint_format(hints_str, handle->detected_hints);
-            printf("hints: \"%s\"\n", hints_str);
+            hpcat_out_printf(out, "{\"type\":\"thread\",\"rank\":%d,\"thread\":%d,\"node\":",
+                             task->id, task->threads[i].id);
+            json_string(out, task->hostname);
+            hpcat_out_printf(out, "%s", node_str);
+            json_affinity(out, &task->threads[i].affinity, bitmap);
+            hpcat_out_printf(out, "}\n");
         }
     }
 
     hwloc_bitmap_free(bitmap);
 }
+
+static void jsonl_summary(Hpcat *handle)
+{
+    hpcat_out_printf(&handle->out, "{\"type\":\"summary\",\"mpiversion\":");
+    json_string(&handle->out, handle->mpi_version);
+    json_prediction(handle);
+    json_totals(handle);
+    hpcat_out_printf(&handle->out, "}\n");
+}
+
+/**
+ * Output data as JSON Lines (appended to the output buffer): one self-contained
+ * record per rank and per OpenMP thread, then a summary record, so that results
+ * can be ingested as a stream.
+ *
+ * @param   handle[inout]       Hpcat handle
+ * @param   task[in]            Task record
+ */
+void hpcat_display_jsonl(Hpcat *handle, Task *task)
+{
+    jsonl_record(handle, task);
+
+    if (task->is_last_rank)
+        jsonl_summary(handle);
+}
+
+/**
+ * Output the header of a YAML or JSON document (parallel output, rank 0)
+ *
+ * @param   handle[inout]       Hpcat handle
+ */
+void hpcat_display_header(Hpcat *handle)
+{
+    switch (handle->settings.output_type)
+    {
+        case YAML:
+            yaml_header(handle);
+            break;
+        case JSON:
+            json_header(handle);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Output the records of a single task, without header nor totals (parallel
+ * output, all ranks)
+ *
+ * @param   handle[inout]       Hpcat handle
+ * @param   task[in]            Task record
+ */
+void hpcat_display_records(Hpcat *handle, Task *task)
+{
+    switch (handle->settings.output_type)
+    {
+        case YAML:
+            yaml_task(handle, task);
+            break;
+        case JSON:
+            json_record(handle, task);
+            break;
+        case JSONL:
+            jsonl_record(handle, task);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Output the totals of the job (parallel output, rank 0)
+ *
+ * @param   handle[inout]       Hpcat handle
+ */
+void hpcat_display_totals(Hpcat *handle)
+{
+    switch (handle->settings.output_type)
+    {
+        case YAML:
+            yaml_totals(handle);
+            break;
+        case JSON:
+            json_end(handle);
+            break;
+        case JSONL:
+            jsonl_summary(handle);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Terminate the output once all sections are written (closes the JSON document)
+ *
+ * @param   handle[inout]       Hpcat handle
+ */
+void hpcat_display_close(Hpcat *handle)
+{
+    if (handle->settings.output_type == JSON)
+        hpcat_out_printf(&handle->out, "}\n");
+}
+
+/**
+ * Name of a phase, as displayed by --timings and recorded by --trace
+ *
+ * @param   phase[in]     Phase
+ * @return                Phase name
+ */
+const char *hpcat_phase_str(const Phase_t phase)
+{
+    return phase_str[phase];
+}
+
+/**
+ * Output per-phase timings of all ranks (--timings), after the table, as the
+ * last YAML or JSON section, or as JSON Lines records. Phases no rank ran are skipped.
+ *
+ * @param   handle[inout] Hpcat handle
+ * @param   stats[in]     Statistics of each phase
+ * @param   hostnames[in] Hostname of each rank (host of the slowest rank)
+ */
+void hpcat_display_timings(Hpcat *handle, const PhaseStats *stats, char (*hostnames)[HOST_NAME_MAX])
+{
+    const OutputType_t type = handle->settings.output_type;
+    OutBuffer *out = &handle->out;
+    int count = 0;
+
+    if (type == YAML)
+        hpcat_out_printf(out, "timings:\n");
+    else if (type == JSON)
+        hpcat_out_printf(out, ",\"timings\":[");
+    else if (type == STDOUT)
+        hpcat_out_printf(out, "%-12s %10s %10s %10s  %s\n", "PHASE", "MIN (s)", "AVG (s)", "MAX (s)",
+                         "SLOWEST RANK (HOST)");
+
+    for (int i = 0; i < PHASE_MAX; i++)
+    {
+        const PhaseStats *phase = &stats[i];
+
+        if (phase->num_ranks == 0)
+            continue;
+
+        switch (type)
+        {
+            case YAML:
+                hpcat_out_printf(out, "%2s- phase: \"%s\"\n", " ", phase_str[i]);
+                hpcat_out_printf(out, "%4sranks: %d\n", " ", phase->num_ranks);
+                hpcat_out_printf(out, "%4smin: %.6f\n", " ", phase->min);
+                hpcat_out_printf(out, "%4savg: %.6f\n", " ", phase->avg);
+                hpcat_out_printf(out, "%4smax: %.6f\n", " ", phase->max);
+                hpcat_out_printf(out, "%4sslowest_rank: %d\n", " ", phase->slowest_rank);
+                hpcat_out_printf(out, "%4sslowest_host: \"%s\"\n", " ", hostnames[phase->slowest_rank]);
+                break;
+            case JSON:
+            case JSONL:
+                hpcat_out_printf(out, "%s{%s\"phase\":\"%s\",\"ranks\":%d,\"min\":%.6f,\"avg\":%.6f,"
+                                 "\"max\":%.6f,\"slowest_rank\":%d,\"slowest_host\":",
+                                 (type == JSON && count++ > 0) ? "," : "",
+                                 (type == JSONL) ? "\"type\":\"timing\"," : "", phase_str[i],
+                                 phase->num_ranks, phase->min, phase->avg, phase->max, phase->slowest_rank);
+                json_string(out, hostnames[phase->slowest_rank]);
+                hpcat_out_write(out, "}\n", (type == JSONL) ? 2 : 1);
+                break;
+            case STDOUT:
+                hpcat_out_printf(out, "%-12s %10.6f %10.6f %10.6f  %d (%s)\n", phase_str[i], phase->min,
+                                 phase->avg, phase->max, phase->slowest_rank, hostnames[phase->slowest_rank]);
+                break;
+        }
+    }
+
+    if (type == JSON)
+        hpcat_out_write(out, "]", 1);
+}
@@ -32,5 +32,13 @@
 
 void hpcat_display_stdout(Hpcat *handle, Task *task);
 void hpcat_display_yaml(Hpcat *handle, Task *task);
+void hpcat_display_json(Hpcat *handle, Task *task);
+void hpcat_display_jsonl(Hpcat *handle, Task *task);
+void hpcat_display_header(Hpcat *handle);
+void hpcat_display_records(Hpcat *handle, Task *task);
+void hpcat_display_totals(Hpcat *handle);
+void hpcat_display_close(Hpcat *handle);
+void hpcat_display_timings(Hpcat *handle, const PhaseStats *stats, char (*hostnames)[HOST_NAME_MAX]);
+const char *hpcat_phase_str(const Phase_t phase);
 
 #endif /* HPCAT_OUTPUT_H */
@@ -0,0 +1,330 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* pcie.c: PCIe path between accelerators and the NIC (GPUDirect RDMA)
+*
+* The PCIe hierarchy is read from sysfs: the canonical path of a device
+* (e.g. /sys/devices/pci0000:c0/0000:c0:01.1/0000:c1:00.0/0000:c2:00.0)
+* lists its host bridge followed by all the ports leading to it.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <hwloc.h>
+
+#include "pcie.h"
+#include "common.h"
+
+#define PCIE_DEPTH_MAX 16
+
+extern hwloc_topology_t topology;
+
+typedef struct
+{
+    char host_bridge[PCI_STR_MAX];
+    char ports[PCIE_DEPTH_MAX][PCI_STR_MAX];  /* Root port first, device excluded */
+    int  num_ports;
+    int  numa_node;                           /* -1 if unknown */
+    int  package;                             /* -1 if unknown */
+} PcieDevice;
+
+static const char * const pcie_path_str[] =
+{
+    [PCIE_PATH_UNKNOWN]      = "unknown",
+    [PCIE_PATH_SWITCH]       = "switch",
+    [PCIE_PATH_ROOT_COMPLEX] = "root-complex",
+    [PCIE_PATH_SOCKET]       = "socket",
+    [PCIE_PATH_CROSS_SOCKET] = "cross-socket",
+};
+
+/**
+ * Name of a PCIe path class
+ *
+ * @param   path[in]      PciePath_t value
+ * @return                Name of the class
+ */
+const char *hpcat_pcie_path_str(const char path)
+{
+    return ((path > PCIE_PATH_UNKNOWN) && (path < PCIE_PATH_MAX)) ? pcie_path_str[(int)path]
+                                                                  : pcie_path_str[PCIE_PATH_UNKNOWN];
+}
+
+/* Package (socket) of a NUMA node, from the hwloc topology */
+static int get_numa_package(const int numa_node)
+{
+    if (numa_node < 0)
+        return -1;
+
+    hwloc_obj_t node = hwloc_get_numanode_obj_by_os_index(topology, numa_node);
+    if (node == NULL)
+        return -1;
+
+    hwloc_obj_t package = hwloc_get_ancestor_obj_by_type(topology, HWLOC_OBJ_PACKAGE, node);
+    return (package != NULL) ? (int)package->logical_index : -1;
+}
+
+/**
+ * Read the position of a device in the PCIe hierarchy
+ *
+ * @param   link[in]      sysfs link to the device (without sysfs root)
+ * @param   dev[out]      PCIe device
+ * @return                Success: 0, Error: -1
+ */
+static int pcie_device_read(const char *link, PcieDevice *dev)
+{
+    char path[PATH_MAX], real[PATH_MAX];
+
+    sysfs_path(path, PATH_MAX - 1, "%s", link);
+    if (realpath(path, real) == NULL)
+        return -1;
+
+    char *pos = strstr(real, "/devices/pci");
+    if (pos == NULL)
+        return -1;
+
+    memset(dev, 0, sizeof(PcieDevice));
+
+    /* NUMA node of the device (unknown if its path does not fit), then its package */
+    dev->numa_node = -1;
+    const int len = snprintf(path, PATH_MAX, "%s/numa_node", real);
+    FILE *file = (len < PATH_MAX) ? fopen(path, "r") : NULL;
+    if (file != NULL)
+    {
+        if (fscanf(file, "%d", &dev->numa_node) != 1)
+            dev->numa_node = -1;
+        fclose(file);
+    }
+
+    dev->package = get_numa_package(dev->numa_node);
+
+    char *saveptr = NULL;
+    char *token = strtok_r(pos + strlen("/devices/"), "/", &saveptr);
+    snprintf(dev->host_bridge, PCI_STR_MAX, "%s", token);
+
+    unsigned int domain, bus, slot, func;
+    while ((token = strtok_r(NULL, "/", &saveptr)) != NULL &&
+           (sscanf(token, "%x:%x:%x.%x", &domain, &bus, &slot, &func) == 4) &&
+           (dev->num_ports < PCIE_DEPTH_MAX))
+        snprintf(dev->ports[dev->num_ports++], PCI_STR_MAX, "%s", token);
+
+    /* The last component is the device itself */
+    if (dev->num_ports == 0)
+        return -1;
+    dev->num_ports--;
+    return 0;
+}
+
+static PciePath_t pcie_path_class(const PcieDevice *a, const PcieDevice *b)
+{
+    if (strcmp(a->host_bridge, b->host_bridge) != 0)
+    {
+        if ((a->numa_node >= 0) && (a->numa_node == b->numa_node))
+            return PCIE_PATH_SOCKET;
+
+        if ((a->package < 0) || (b->package < 0))
+            return PCIE_PATH_UNKNOWN;
+
+        return (a->package == b->package) ? PCIE_PATH_SOCKET : PCIE_PATH_CROSS_SOCKET;
+    }
+
+    int common = 0;
+    while ((common < a->num_ports) && (common < b->num_ports) &&
+           (strcmp(a->ports[common], b->ports[common]) == 0))
+        common++;
+
+    /* A root port links to a single device: sharing it means sharing a switch, or being
+     * functions of the same device */
+    return (common > 0) ? PCIE_PATH_SWITCH : PCIE_PATH_ROOT_COMPLEX;
+}
+
+/* Find the sysfs link of the first device on a bus (backends only report domain and bus) */
+static int get_device_link_by_bus(char *link, const unsigned int domain, const unsigned int bus)
+{
+    char path[PATH_MAX], prefix[PCI_STR_MAX];
+
+    sysfs_path(path, PATH_MAX - 1, "/sys/bus/pci/devices");
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+        return -1;
+
+    int ret = -1;
+    struct dirent *entry;
+    snprintf(prefix, PCI_STR_MAX, "%04x:%02x:", domain, bus);
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strncmp(entry->d_name, prefix, strlen(prefix)) == 0)
+        {
+            snprintf(link, PATH_MAX - 1, "/sys/bus/pci/devices/%s", entry->d_name);
+            ret = 0;
+            break;
+        }
+    }
+
+    closedir(dir);
+    return ret;
+}
+
+/* Classes of the devices MPI may report: network interfaces, or InfiniBand devices (mlx5_0) */
+static const char * const nic_classes[] = { "/sys/class/net", "/sys/class/infiniband" };
+
+#define NIC_CLASSES_MAX (int)(sizeof(nic_classes) / sizeof(nic_classes[0]))
+
+/**
+ * Retrieve the network device used by the task. Cray MPICH reports the CXI
+ * domain (cxiN) of a Slingshot interface (hsnN).
+ *
+ * @param   nic_name[in]     NIC reported by MPI
+ * @param   net_name[out]    Network device name
+ * @param   dev[out]         PCIe device of the interface
+ * @return                   Success: class of the device (sysfs path), Error: NULL
+ */
+static const char *get_nic_device(const char *nic_name, char *net_name, PcieDevice *dev)
+{
+    char link[PATH_MAX];
+
+    if (strncmp(nic_name, "cxi", 3) == 0)
+        snprintf(net_name, NIC_STR_MAX, "hsn%s", nic_name + 3);
+    else
+        snprintf(net_name, NIC_STR_MAX, "%s", nic_name);
+
+    for (int i = 0; i < NIC_CLASSES_MAX; i++)
+    {
+        snprintf(link, PATH_MAX - 1, "%s/%s/device", nic_classes[i], net_name);
+        if (pcie_device_read(link, dev) == 0)
+            return nic_classes[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Classify the PCIe path between the accelerators and the NIC of a task,
+ * and check if another NIC of the same kind is closer to its accelerators.
+ *
+ * @param   hpcat[in]        Application handle
+ * @param   task[inout]      Task handle
+ */
+void hpcat_pcie_path_get(Hpcat *hpcat, Task *task)
+{
+    char nic_name[NIC_STR_MAX], net_name[NIC_STR_MAX], path[PATH_MAX];
+    PcieDevice nic, *gpus;
+    int num_gpus = 0, max_gpus = 0;
+
+    task->nic.gpu_path = PCIE_PATH_UNKNOWN;
+    task->nic.has_closer_nic = false;
+
+    if ((task->nic.num_nic == 0) || (task->accel.num_accel == 0))
+        return;
+
+    nic_first_name(&task->nic, nic_name);
+    const char *nic_class = get_nic_device(nic_name, net_name, &nic);
+    if (nic_class == NULL)
+    {
+        VERBOSE(hpcat, "Verbose: no PCIe device found for the NIC %s of rank %d.\n", nic_name, task->id);
+        return;
+    }
+
+    /* Accelerators, from the list of PCIe addresses "[d:b],[d:b]" */
+    for (const char *pos = strchr(task->accel.pciaddr, '['); pos != NULL; pos = strchr(pos + 1, '['))
+        max_gpus++;
+
+    gpus = malloc(max_gpus * sizeof(PcieDevice));
+    if (gpus == NULL)
+        return;
+
+    for (const char *pos = strchr(task->accel.pciaddr, '['); pos != NULL; pos = strchr(pos + 1, '['))
+    {
+        unsigned int domain, bus;
+        char link[PATH_MAX];
+
+        if ((sscanf(pos, "[%x:%x]", &domain, &bus) == 2) &&
+            (get_device_link_by_bus(link, domain, bus) == 0) &&
+            (pcie_device_read(link, &gpus[num_gpus]) == 0))
+            num_gpus++;
+    }
+
+    /* Closest path between any accelerator of the task and its NIC */
+    PciePath_t best = PCIE_PATH_MAX;
+    for (int i = 0; i < num_gpus; i++)
+    {
+        PciePath_t path_class = pcie_path_class(&gpus[i], &nic);
+        if ((path_class != PCIE_PATH_UNKNOWN) && (path_class < best))
+            best = path_class;
+    }
+
+    if (best == PCIE_PATH_MAX)
+    {
+        free(gpus);
+        return;
+    }
+
+    task->nic.gpu_path = best;
+
+    /* Other interfaces of the same kind (e.g. hsn*, mlx5_*) */
+    size_t prefix_len = 0;
+    while (net_name[prefix_len] != '\0' && !isdigit((unsigned char)net_name[prefix_len]))
+        prefix_len++;
+
+    sysfs_path(path, PATH_MAX - 1, "%s", nic_class);
+    DIR *dir = (prefix_len > 0) ? opendir(path) : NULL;
+    if (dir == NULL)
+    {
+        free(gpus);
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && !task->nic.has_closer_nic)
+    {
+        char link[PATH_MAX];
+        PcieDevice other;
+
+        if ((strncmp(entry->d_name, net_name, prefix_len) != 0) ||
+            (strcmp(entry->d_name, net_name) == 0))
+            continue;
+
+        snprintf(link, PATH_MAX - 1, "%s/%s/device", nic_class, entry->d_name);
+        if (pcie_device_read(link, &other) != 0)
+            continue;
+
+        for (int i = 0; i < num_gpus; i++)
+        {
+            PciePath_t path_class = pcie_path_class(&gpus[i], &other);
+            if ((path_class != PCIE_PATH_UNKNOWN) && (path_class < best))
+            {
+                VERBOSE(hpcat, "Verbose: %s is closer than %s to a GPU of rank %d (%s).\n",
+                        entry->d_name, net_name, task->id, hpcat_pcie_path_str(path_class));
+                task->nic.has_closer_nic = true;
+            }
+        }
+    }
+
+    closedir(dir);
+    free(gpus);
+}
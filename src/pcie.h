@@ -0,0 +1,47 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* pcie.h: PCIe path between accelerators and the NIC (GPUDirect RDMA)
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#ifndef HPCAT_PCIE_H
+#define HPCAT_PCIE_H
+
+#include "hpcat.h"
+
+/* Path between two PCIe devices, from the closest to the farthest */
+typedef enum PciePath
+{
+    PCIE_PATH_UNKNOWN = 0,
+    PCIE_PATH_SWITCH,        /* Behind the same PCIe switch or device    */
+    PCIE_PATH_ROOT_COMPLEX,  /* Same host bridge, different root ports   */
+    PCIE_PATH_SOCKET,        /* Same socket, different host bridges      */
+    PCIE_PATH_CROSS_SOCKET,  /* Different sockets                        */
+    PCIE_PATH_MAX
+} PciePath_t;
+
+const char *hpcat_pcie_path_str(const char path);
+void hpcat_pcie_path_get(Hpcat *hpcat, Task *task);
+
+#endif /* HPCAT_PCIE_H */
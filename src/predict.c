@@ -0,0 +1,580 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* predict.c: Placement predicted from launcher settings, without running the
+*            application (--predict).
+*
+* The node topology is the live one, a saved hwloc XML file or a synthetic
+* description. Launcher inputs are read from the environment, as set in a batch
+* script: Slurm CPUs per task, CPU binding, multithreading hint and GPUs per task,
+* and the OpenMP number of threads, places and binding policy. Tasks are placed
+* with a block distribution (consecutive CPUs, hardware threads of a core first),
+* which is the Slurm default within a node. Each task is allocated whole cores
+* (CR_Core, the default on HPE Cray systems): with fewer CPUs per task than
+* hardware threads per core, the other threads of its last core stay idle.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "predict.h"
+#include "common.h"
+
+typedef enum ProcBind
+{
+    PROC_BIND_FALSE = 0,     /* Threads not bound, they use all CPUs of the task */
+    PROC_BIND_CLOSE,
+    PROC_BIND_SPREAD,
+    PROC_BIND_PRIMARY
+} ProcBind_t;
+
+/* Launcher and OpenMP settings of the predicted job */
+typedef struct
+{
+    int               cpus_per_task;
+    bool              is_nomultithread;
+    hwloc_obj_type_t  cpu_bind;         /* Binding unit, HWLOC_OBJ_MACHINE if not bound */
+    int               num_threads;      /* 0: one per CPU of the task */
+    hwloc_obj_type_t  omp_places;
+    ProcBind_t        omp_proc_bind;
+    int               gpus_per_task;    /* 0: all GPUs visible */
+    bool              is_gpu_closest;
+} Launcher;
+
+/* Accelerator found in the topology (PCIe device of a display or processing class) */
+typedef struct
+{
+    unsigned int   domain;
+    unsigned int   bus;
+    hwloc_bitmap_t numa_affinity;
+    bool           is_assigned;
+} PredictGpu;
+
+typedef struct
+{
+    const char       *name;
+    hwloc_obj_type_t type;
+} ObjName;
+
+static const ObjName cpu_bind_names[] =
+{
+    { "none",    HWLOC_OBJ_MACHINE  },
+    { "threads", HWLOC_OBJ_PU       },
+    { "cores",   HWLOC_OBJ_CORE     },
+    { "sockets", HWLOC_OBJ_PACKAGE  },
+    { "ldoms",   HWLOC_OBJ_NUMANODE },
+};
+
+static const ObjName omp_places_names[] =
+{
+    { "threads",      HWLOC_OBJ_PU       },
+    { "cores",        HWLOC_OBJ_CORE     },
+    { "sockets",      HWLOC_OBJ_PACKAGE  },
+    { "ll_caches",    HWLOC_OBJ_L3CACHE  },
+    { "numa_domains", HWLOC_OBJ_NUMANODE },
+};
+
+#define CPU_BIND_NAMES_MAX   (int)(sizeof(cpu_bind_names) / sizeof(cpu_bind_names[0]))
+#define OMP_PLACES_NAMES_MAX (int)(sizeof(omp_places_names) / sizeof(omp_places_names[0]))
+
+static const char *const proc_bind_str[] =
+{
+    [PROC_BIND_FALSE]   = "false",
+    [PROC_BIND_CLOSE]   = "close",
+    [PROC_BIND_SPREAD]  = "spread",
+    [PROC_BIND_PRIMARY] = "primary",
+};
+
+static const char *obj_name(const ObjName *names, const int count, const hwloc_obj_type_t type)
+{
+    for (int i = 0; i < count; i++)
+        if (names[i].type == type)
+            return names[i].name;
+
+    return "";
+}
+
+/* Positive integer from the environment, Slurm GPU counts may be prefixed by a type (mi250x:1) */
+static int env_int(const char *name, const int default_value)
+{
+    const char *value = getenv(name);
+    if ((value == NULL) || (value[0] == '\0'))
+        return default_value;
+
+    const char *number = strrchr(value, ':');
+    number = (number != NULL) ? number + 1 : value;
+
+    char *endptr;
+    const long result = strtol(number, &endptr, 10);
+    if ((endptr == number) || (*endptr != '\0') || (result <= 0) || (result > MAX_DEVICE_ID))
+        FATAL("Error: invalid %s=%s for --predict. Exiting.\n", name, value);
+
+    return (int)result;
+}
+
+/* Whether a comma separated environment variable holds a keyword */
+static bool env_has(const char *value, const char *keyword)
+{
+    const size_t len = strlen(keyword);
+
+    for (const char *pos = value; (pos = strstr(pos, keyword)) != NULL; pos += len)
+        if (((pos == value) || (pos[-1] == ',')) && ((pos[len] == ',') || (pos[len] == '\0')))
+            return true;
+
+    return false;
+}
+
+static void parse_launcher(Launcher *launcher, const HpcatSettings_t *settings)
+{
+    launcher->cpus_per_task = env_int("SLURM_CPUS_PER_TASK", 1);
+    launcher->gpus_per_task = env_int("SLURM_GPUS_PER_TASK", 0);
+    launcher->num_threads = env_int("OMP_NUM_THREADS", 0);
+
+    const char *hint = getenv("SLURM_HINT");
+    launcher->is_nomultithread = (hint != NULL) && env_has(hint, "nomultithread");
+
+    /* Slurm binds tasks to cores by default (task/affinity plugin) */
+    launcher->cpu_bind = HWLOC_OBJ_CORE;
+    const char *cpu_bind = getenv("SLURM_CPU_BIND");
+    if ((cpu_bind != NULL) && (cpu_bind[0] != '\0'))
+    {
+        int i;
+        for (i = 0; i < CPU_BIND_NAMES_MAX; i++)
+            if (env_has(cpu_bind, cpu_bind_names[i].name))
+                break;
+
+        if (i == CPU_BIND_NAMES_MAX)
+            FATAL("Error: SLURM_CPU_BIND=%s is not supported by --predict (none, threads, cores, sockets "
+                  "or ldoms). Exiting.\n", cpu_bind);
+
+        launcher->cpu_bind = cpu_bind_names[i].type;
+    }
+
+    const char *gpu_bind = getenv("SLURM_GPU_BIND");
+    launcher->is_gpu_closest = (gpu_bind != NULL) && env_has(gpu_bind, "closest");
+    if ((gpu_bind != NULL) && (gpu_bind[0] != '\0') && !launcher->is_gpu_closest && !env_has(gpu_bind, "none"))
+        FATAL("Error: SLURM_GPU_BIND=%s is not supported by --predict (closest or none). Exiting.\n", gpu_bind);
+
+    /* Unset OpenMP binding: threads are not bound, unless places are given. Places are
+     * cores if only a binding policy is given (implementation defined). */
+    const char *places = getenv("OMP_PLACES");
+    const char *proc_bind = getenv("OMP_PROC_BIND");
+    const bool has_places = (places != NULL) && (places[0] != '\0');
+    const bool has_proc_bind = (proc_bind != NULL) && (proc_bind[0] != '\0');
+
+    launcher->omp_places = HWLOC_OBJ_CORE;
+    if (has_places)
+    {
+        int i;
+        for (i = 0; i < OMP_PLACES_NAMES_MAX; i++)
+            if (strcasecmp(places, omp_places_names[i].name) == 0)
+                break;
+
+        if (i == OMP_PLACES_NAMES_MAX)
+            FATAL("Error: OMP_PLACES=%s is not supported by --predict (threads, cores, sockets, ll_caches "
+                  "or numa_domains). Exiting.\n", places);
+
+        launcher->omp_places = omp_places_names[i].type;
+    }
+
+    launcher->omp_proc_bind = has_places ? PROC_BIND_CLOSE : PROC_BIND_FALSE;
+    if (has_proc_bind)
+    {
+        /* Only the policy of the outermost level matters */
+        const size_t len = strcspn(proc_bind, ",");
+
+        if ((strncasecmp(proc_bind, "true", len) == 0) || (strncasecmp(proc_bind, "close", len) == 0))
+            launcher->omp_proc_bind = PROC_BIND_CLOSE;
+        else if (strncasecmp(proc_bind, "spread", len) == 0)
+            launcher->omp_proc_bind = PROC_BIND_SPREAD;
+        else if ((strncasecmp(proc_bind, "primary", len) == 0) || (strncasecmp(proc_bind, "master", len) == 0))
+            launcher->omp_proc_bind = PROC_BIND_PRIMARY;
+        else if (strncasecmp(proc_bind, "false", len) == 0)
+            launcher->omp_proc_bind = PROC_BIND_FALSE;
+        else
+            FATAL("Error: OMP_PROC_BIND=%s is not supported by --predict. Exiting.\n", proc_bind);
+    }
+
+    if (!settings->enable_omp)
+        launcher->num_threads = 1;
+}
+
+static void load_topology(hwloc_topology_t *topo, const char *source)
+{
+    if (hwloc_topology_init(topo) != 0)
+        FATAL("Error: unable to initialize hwloc. Exiting.\n");
+
+    /* Accelerators are PCIe devices of the topology */
+    hwloc_topology_set_io_types_filter(*topo, HWLOC_TYPE_FILTER_KEEP_IMPORTANT);
+
+    if (source == NULL)
+    {
+        /* Same sources as the probe of a running task (hpcat_init) */
+        setenv("HWLOC_THISSYSTEM", "1", 1);
+
+        char *sysfs_root = getenv(SYSFS_ROOT_ENV);
+        if (sysfs_root != NULL)
+            setenv("HWLOC_FSROOT", sysfs_root, 0);
+    }
+    else if (access(source, R_OK) == 0)
+    {
+        if (hwloc_topology_set_xml(*topo, source) != 0)
+            FATAL("Error: unable to read the hwloc topology %s. Exiting.\n", source);
+    }
+    else if (hwloc_topology_set_synthetic(*topo, source) != 0)
+        FATAL("Error: %s is neither a readable XML file nor a synthetic topology. Exiting.\n", source);
+
+    if (hwloc_topology_load(*topo) != 0)
+        FATAL("Error: unable to load the hwloc topology. Exiting.\n");
+}
+
+/* Display and processing accelerators, in PCIe order */
+static PredictGpu *find_gpus(hwloc_topology_t topo, int *num_gpus)
+{
+    PredictGpu *gpus = NULL;
+    int capacity = 0;
+    hwloc_obj_t obj = NULL;
+
+    *num_gpus = 0;
+    while ((obj = hwloc_get_next_pcidev(topo, obj)) != NULL)
+    {
+        const unsigned int class_id = obj->attr->pcidev.class_id;
+        if ((class_id != 0x0300) && (class_id != 0x0302) && (class_id != 0x0380) && (class_id != 0x1200))
+            continue;
+
+        /* One entry per device, functions are ignored */
+        if ((*num_gpus > 0) && (gpus[*num_gpus - 1].domain == obj->attr->pcidev.domain) &&
+            (gpus[*num_gpus - 1].bus == obj->attr->pcidev.bus))
+            continue;
+
+        if (array_grow(&gpus, &capacity, *num_gpus, sizeof(PredictGpu)) != 0)
+            FATAL("Error: unable to allocate accelerators. Exiting.\n");
+
+        PredictGpu *gpu = &gpus[(*num_gpus)++];
+        gpu->domain = obj->attr->pcidev.domain;
+        gpu->bus = obj->attr->pcidev.bus;
+        gpu->is_assigned = false;
+        gpu->numa_affinity = hwloc_bitmap_alloc();
+        if (gpu->numa_affinity == NULL)
+            FATAL("Error: unable to allocate a hwloc bitmap. Exiting.\n");
+
+        /* NUMA nodes by logical index, as for the CPU affinity */
+        hwloc_obj_t parent = hwloc_get_non_io_ancestor_obj(topo, obj);
+        const int num_numa = hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_NUMANODE);
+        for (int i = 0; (parent != NULL) && (i < num_numa); i++)
+        {
+            hwloc_obj_t node = hwloc_get_obj_by_type(topo, HWLOC_OBJ_NUMANODE, i);
+            if (hwloc_bitmap_isset(parent->nodeset, node->os_index))
+                hwloc_bitmap_set(gpu->numa_affinity, i);
+        }
+    }
+
+    return gpus;
+}
+
+/* Same conventions as get_cpu_numa_affinity() (cores by first hardware thread, NUMA by logical index) */
+static void set_affinity(hwloc_topology_t topo, Affinity *affinity, hwloc_const_bitmap_t cpuset)
+{
+    hwloc_bitmap_t core_affinity = hwloc_bitmap_alloc();
+    hwloc_bitmap_t numa_affinity = hwloc_bitmap_alloc();
+    if ((core_affinity == NULL) || (numa_affinity == NULL))
+        FATAL("Error: unable to allocate a hwloc bitmap. Exiting.\n");
+
+    hwloc_obj_t core = NULL;
+    while ((core = hwloc_get_next_obj_by_type(topo, HWLOC_OBJ_CORE, core)) != NULL)
+        if (hwloc_bitmap_intersects(cpuset, core->cpuset))
+            hwloc_bitmap_set(core_affinity, hwloc_bitmap_first(core->cpuset));
+
+    const int num_numa = hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_NUMANODE);
+    for (int i = 0; i < num_numa; i++)
+    {
+        hwloc_obj_t node = hwloc_get_obj_by_type(topo, HWLOC_OBJ_NUMANODE, i);
+        if (hwloc_bitmap_intersects(cpuset, node->cpuset))
+            hwloc_bitmap_set(numa_affinity, i);
+    }
+
+    serialize_bitmap(&affinity->hw_thread_affinity, (hwloc_bitmap_t)cpuset);
+    serialize_bitmap(&affinity->core_affinity, core_affinity);
+    serialize_bitmap(&affinity->numa_affinity, numa_affinity);
+
+    hwloc_bitmap_free(core_affinity);
+    hwloc_bitmap_free(numa_affinity);
+}
+
+/* First CPU after the core of cpus[pos - 1], the next task starts on a new core */
+static int next_core_cpu(hwloc_topology_t topo, hwloc_obj_t *cpus, const int num_cpus, int pos)
+{
+    hwloc_obj_t core = hwloc_get_ancestor_obj_by_type(topo, HWLOC_OBJ_CORE, cpus[pos - 1]);
+
+    while ((core != NULL) && (pos < num_cpus) && hwloc_bitmap_isset(core->cpuset, cpus[pos]->os_index))
+        pos++;
+
+    return pos;
+}
+
+/* Extend a cpuset to all objects of a type it intersects (binding unit) */
+static void expand_cpuset(hwloc_topology_t topo, hwloc_bitmap_t cpuset, const hwloc_obj_type_t type)
+{
+    if (type == HWLOC_OBJ_MACHINE)
+    {
+        hwloc_bitmap_copy(cpuset, hwloc_topology_get_topology_cpuset(topo));
+        return;
+    }
+
+    hwloc_bitmap_t expanded = hwloc_bitmap_dup(cpuset);
+    hwloc_obj_t obj = NULL;
+    while ((obj = hwloc_get_next_obj_by_type(topo, type, obj)) != NULL)
+        if (hwloc_bitmap_intersects(cpuset, obj->cpuset))
+            hwloc_bitmap_or(expanded, expanded, obj->cpuset);
+
+    hwloc_bitmap_copy(cpuset, expanded);
+    hwloc_bitmap_free(expanded);
+}
+
+/* OpenMP threads bound to the places of the task following the binding policy */
+static void set_threads(hwloc_topology_t topo, const Launcher *launcher, Task *task, hwloc_const_bitmap_t cpuset)
+{
+    const int num_threads = (launcher->num_threads > 0) ? launcher->num_threads : hwloc_bitmap_weight(cpuset);
+    hwloc_bitmap_t places[hwloc_bitmap_weight(cpuset)];
+    int num_places = 0;
+
+    /* Places are the objects of the place type within the CPUs of the task */
+    hwloc_obj_t obj = NULL;
+    while ((obj = hwloc_get_next_obj_by_type(topo, launcher->omp_places, obj)) != NULL)
+    {
+        if (!hwloc_bitmap_intersects(cpuset, obj->cpuset))
+            continue;
+
+        places[num_places] = hwloc_bitmap_alloc();
+        hwloc_bitmap_and(places[num_places], cpuset, obj->cpuset);
+        num_places++;
+    }
+
+    /* Type absent from the topology (e.g. no L3 in a synthetic topology) */
+    if (num_places == 0)
+        places[num_places++] = hwloc_bitmap_dup(cpuset);
+
+    task->threads = calloc(num_threads, sizeof(Thread));
+    if (task->threads == NULL)
+        FATAL("Error: unable to allocate threads buffer. Exiting.\n");
+    task->num_threads = num_threads;
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        int place = 0;
+        if ((launcher->omp_proc_bind == PROC_BIND_CLOSE) && (num_threads <= num_places))
+            place = i;
+        else if ((launcher->omp_proc_bind == PROC_BIND_CLOSE) || (launcher->omp_proc_bind == PROC_BIND_SPREAD))
+            place = (int)((long long)i * num_places / num_threads);
+
+        task->threads[i].id = i;
+        set_affinity(topo, &task->threads[i].affinity,
+                     (launcher->omp_proc_bind == PROC_BIND_FALSE) ? cpuset : places[place]);
+    }
+
+    for (int i = 0; i < num_places; i++)
+        hwloc_bitmap_free(places[i]);
+}
+
+/* GPUs of a task: all of them, or the closest unassigned ones with --gpu-bind=closest */
+static void set_gpus(const Launcher *launcher, Task *task, PredictGpu *gpus, const int num_gpus,
+                     const int num_tasks)
+{
+    hwloc_bitmap_t visible = hwloc_bitmap_alloc();
+    hwloc_bitmap_t numa_affinity = hwloc_bitmap_alloc();
+    hwloc_bitmap_t task_numa = hwloc_bitmap_alloc();
+    if ((visible == NULL) || (numa_affinity == NULL) || (task_numa == NULL))
+        FATAL("Error: unable to allocate a hwloc bitmap. Exiting.\n");
+
+    hwloc_bitmap_from_ulongs(task_numa, task->affinity.numa_affinity.num_ulongs,
+                             task->affinity.numa_affinity.ulongs);
+
+    /* Without binding, tasks see all GPUs of the step on the node */
+    const int num_step_gpus = (launcher->gpus_per_task > 0) ? launcher->gpus_per_task * num_tasks : num_gpus;
+
+    if ((launcher->gpus_per_task > 0) && launcher->is_gpu_closest)
+    {
+        /* First pass on GPUs sharing a NUMA node with the task, then any */
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int i = 0; (i < num_gpus) && (hwloc_bitmap_weight(visible) < launcher->gpus_per_task); i++)
+            {
+                if (gpus[i].is_assigned || ((pass == 0) && !hwloc_bitmap_intersects(gpus[i].numa_affinity, task_numa)))
+                    continue;
+
+                gpus[i].is_assigned = true;
+                hwloc_bitmap_set(visible, i);
+            }
+        }
+    }
+    else
+        set_first_bits_bitmap(visible, num_step_gpus);
+
+    int i;
+    hwloc_bitmap_foreach_begin(i, visible)
+    {
+        snprintf(task->accel.pciaddr + strlen(task->accel.pciaddr), STR_MAX - strlen(task->accel.pciaddr),
+                 "%s[%01x:%02x]", (task->accel.num_accel == 0) ? "" : ",", gpus[i].domain, gpus[i].bus);
+        hwloc_bitmap_or(numa_affinity, numa_affinity, gpus[i].numa_affinity);
+        task->accel.num_accel++;
+    }
+    hwloc_bitmap_foreach_end();
+
+    serialize_bitmap(&task->accel.numa_affinity, numa_affinity);
+    serialize_bitmap(&task->accel.visible_devices, visible);
+
+    hwloc_bitmap_free(visible);
+    hwloc_bitmap_free(numa_affinity);
+    hwloc_bitmap_free(task_numa);
+}
+
+/**
+ * Predict the placement of the tasks of a node from the launcher settings of the
+ * environment (--predict), without MPI. The number of tasks, the MPI version string
+ * (description of the prediction) and the settings of the handle are set.
+ *
+ * @param   hpcat[inout]   Application handle
+ * @return                 Task records indexed by rank, release with hpcat_task_free()
+ */
+Task *hpcat_predict(Hpcat *hpcat)
+{
+    HpcatSettings_t *settings = &hpcat->settings;
+    hwloc_topology_t topo;
+    Launcher launcher;
+
+    parse_launcher(&launcher, settings);
+    load_topology(&topo, settings->predict_topology);
+
+    /* CPUs the launcher counts: hardware threads, or cores without multithreading */
+    const int num_pus = hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_PU);
+    if (num_pus <= 0)
+        FATAL("Error: no hardware thread found in the topology. Exiting.\n");
+
+    hwloc_obj_t *cpus = malloc(num_pus * sizeof(hwloc_obj_t));
+    hwloc_bitmap_t usable = hwloc_bitmap_alloc();
+    int num_cpus = 0;
+
+    if ((cpus == NULL) || (usable == NULL))
+        FATAL("Error: unable to allocate CPUs buffer. Exiting.\n");
+
+    for (int i = 0; i < num_pus; i++)
+    {
+        hwloc_obj_t pu = hwloc_get_obj_by_type(topo, HWLOC_OBJ_PU, i);
+        hwloc_obj_t core = hwloc_get_ancestor_obj_by_type(topo, HWLOC_OBJ_CORE, pu);
+
+        if (launcher.is_nomultithread && (core != NULL) && ((int)pu->os_index != hwloc_bitmap_first(core->cpuset)))
+            continue;
+
+        cpus[num_cpus++] = pu;
+        hwloc_bitmap_set(usable, pu->os_index);
+    }
+
+    hpcat->num_tasks = settings->predict_tasks;
+
+    /* First CPU of each task, tasks are allocated whole cores */
+    int *first_cpus = malloc(hpcat->num_tasks * sizeof(int));
+    if (first_cpus == NULL)
+        FATAL("Error: unable to allocate CPUs buffer. Exiting.\n");
+
+    for (int i = 0, next = 0; i < hpcat->num_tasks; i++)
+    {
+        if (next + launcher.cpus_per_task > num_cpus)
+            FATAL("Error: %d tasks of %d CPUs (whole cores) do not fit in the %d CPUs of the node. Exiting.\n",
+                  hpcat->num_tasks, launcher.cpus_per_task, num_cpus);
+
+        first_cpus[i] = next;
+        next = next_core_cpu(topo, cpus, num_cpus, next + launcher.cpus_per_task);
+    }
+
+    int num_gpus = 0;
+    PredictGpu *gpus = settings->enable_accel ? find_gpus(topo, &num_gpus) : NULL;
+    if (hpcat->num_tasks * launcher.gpus_per_task > num_gpus)
+        FATAL("Error: %d tasks of %d GPUs do not fit in the %d GPUs of the node. Exiting.\n",
+              hpcat->num_tasks, launcher.gpus_per_task, num_gpus);
+
+    char hostname[HOST_NAME_MAX] = "predicted";
+    if (settings->predict_topology == NULL)
+        gethostname(hostname, HOST_NAME_MAX - 1);
+
+    Task *tasks = calloc(hpcat->num_tasks, sizeof(Task));
+    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+    if ((tasks == NULL) || (cpuset == NULL))
+        FATAL("Error: unable to allocate tasks buffer. Exiting.\n");
+
+    for (int i = 0; i < hpcat->num_tasks; i++)
+    {
+        Task *task = &tasks[i];
+
+        task->id = i;
+        snprintf(task->hostname, HOST_NAME_MAX, "%s", hostname);
+
+        /* Block distribution, then extended to the binding unit */
+        hwloc_bitmap_zero(cpuset);
+        for (int j = 0; j < launcher.cpus_per_task; j++)
+            hwloc_bitmap_or(cpuset, cpuset, cpus[first_cpus[i] + j]->cpuset);
+
+        expand_cpuset(topo, cpuset, launcher.cpu_bind);
+        if (launcher.is_nomultithread && (launcher.cpu_bind != HWLOC_OBJ_MACHINE))
+            hwloc_bitmap_and(cpuset, cpuset, usable);
+
+        set_affinity(topo, &task->affinity, cpuset);
+
+        if (settings->enable_omp)
+            set_threads(topo, &launcher, task, cpuset);
+
+        if (num_gpus > 0)
+            set_gpus(&launcher, task, gpus, num_gpus, hpcat->num_tasks);
+    }
+
+    /* Single node: no NIC, fabric or I/O locality */
+    settings->enable_nic = false;
+    settings->enable_fabric = false;
+    settings->enable_io_locality = false;
+
+    snprintf(hpcat->mpi_version, MPI_MAX_LIBRARY_VERSION_STRING, "none");
+    snprintf(hpcat->prediction, STR_MAX,
+             "Predicted on %s: cpus-per-task=%d (whole cores), cpu-bind=%s%s, OMP_PLACES=%s, OMP_PROC_BIND=%s, gpus-per-task=%d%s",
+             (settings->predict_topology != NULL) ? settings->predict_topology : "the live topology",
+             launcher.cpus_per_task, obj_name(cpu_bind_names, CPU_BIND_NAMES_MAX, launcher.cpu_bind),
+             launcher.is_nomultithread ? ", hint=nomultithread" : "",
+             obj_name(omp_places_names, OMP_PLACES_NAMES_MAX, launcher.omp_places),
+             proc_bind_str[launcher.omp_proc_bind], launcher.gpus_per_task,
+             launcher.is_gpu_closest ? ", gpu-bind=closest" : "");
+
+    VERBOSE(hpcat, "Verbose: %d tasks predicted on %d CPUs and %d GPUs.\n", hpcat->num_tasks, num_cpus, num_gpus);
+
+    for (int i = 0; i < num_gpus; i++)
+        hwloc_bitmap_free(gpus[i].numa_affinity);
+    free(gpus);
+    free(cpus);
+    free(first_cpus);
+    hwloc_bitmap_free(cpuset);
+    hwloc_bitmap_free(usable);
+    hwloc_topology_destroy(topo);
+
+    return tasks;
+}
@@ -50,20 +50,37 @@ static char doc[] = "This application is designed to display NUMA and CPU affini
 /* A description of the arguments we accept (in addition to the options) */
 static char args_doc[] = " ";
 
-/* Options */
+/* Options, keys by group: 1x enable, 2x disable, 3x other. Keys from 32 are printable
+ * (short options), so the output and mode options use the keys below 10 */
 static struct argp_option options[] =
 {
-    {"enable-omp",         11,  0,         0,  "Display OpenMP affinities"},
-    {"enable-color-light", 12,  0,         0,  "Using colors (light terminal)"},
-    {"enable-color-dark", 'c',  0,         0,  "Using colors (dark terminal)"},
-    {"disable-omp",        21,  0,         0,  "Don't display OpenMP affinities"},
-    {"disable-nic",        23,  0,         0,  "Don't display Network affinities"},
-    {"disable-accel",      24,  0,         0,  "Don't display GPU affinities"},
-    {"disable-fabric",     25,  0,         0,  "Don't display fabric group ID"},
-    {"disable-hints",      26,  0,         0,  "Don't display hints"},
-    {"no-banner",          31,  0,         0,  "Don't display header/footer"},
-    {"verbose",            'v', 0,         0,  "Make the operations talkative"},
-    {"yaml",               'y', 0,         0,  "YAML output"},
+    {"enable-omp",            11,  0,         0,  "Display OpenMP affinities"},
+    {"enable-color-light",    12,  0,         0,  "Using colors (light terminal)"},
+    {"enable-color-dark",     'c', 0,         0,  "Using colors (dark terminal)"},
+    {"enable-io-locality",    13,  0,         0,  "Display closest cores/L3 of GPUs and NIC"},
+    {"disable-omp",           21,  0,         0,  "Don't display OpenMP affinities"},
+    {"disable-nic",           23,  0,         0,  "Don't display Network affinities"},
+    {"disable-accel",         24,  0,         0,  "Don't display GPU affinities"},
+    {"disable-accel-runtime", 27,  0,         0,  "Detect GPUs from sysfs only"},
+    {"disable-fabric",        25,  0,         0,  "Don't display fabric group ID"},
+    {"disable-hints",         26,  0,         0,  "Don't display hints"},
+    {"no-banner",             31,  0,         0,  "Don't display header/footer"},
+    {"topology-cache",        14,  "DIR",     0,  "Cache node topologies in DIR"},
+    {"fused-gather",          15,  0,         0,  "Exchange results in a single collective"},
+    {"mpi-sessions",          16,  0,         0,  "Initialize MPI with sessions (MPI-4)"},
+    {"timings",               17,  0,         0,  "Display per-phase timings of all ranks"},
+    {"trace",                 18,  "FILE",    0,  "Write a Chrome trace of all ranks to FILE"},
+    {"json",                  1,   0,         0,  "JSON output"},
+    {"jsonl",                 2,   0,         0,  "JSON Lines output (one record per rank and thread)"},
+    {"output",                3,   "FILE",    0,  "Write YAML/JSON output to FILE in parallel (MPI-IO)"},
+    {"save",                  4,   "FILE",    0,  "Save the records of all ranks to FILE"},
+    {"replay",                5,   "FILE",    0,  "Display the records saved in FILE (no MPI)"},
+    {"diff",                  6,   "A",       0,  "Compare the runs saved in A and B (--diff A B)"},
+    {"expect",                7,   "SPEC",    0,  "Exit with an error if placement rules are not met"},
+    {"predict",               8,   "TASKS",   0,  "Predict the placement of TASKS tasks (no MPI)"},
+    {"predict-topology",      9,   "SRC",     0,  "Topology of --predict (XML file or synthetic)"},
+    {"verbose",               'v', 0,         0,  "Make the operations talkative"},
+    {"yaml",                  'y', 0,         0,  "YAML output"},
     {0}
 };
 
@@ -80,6 +97,9 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         case  12:
             settings->color_type = LIGHT_BG;
             break;
+        case  13:
+            settings->enable_io_locality = true;
+            break;
         case  21:
             settings->enable_omp = false;
             break;
@@ -95,9 +115,63 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         case  26:
             settings->enable_hints = false;
             break;
+        case  27:
+            settings->enable_accel_runtime = false;
+            break;
         case  31:
             settings->enable_banner = false;
             break;
+        case  14:
+            settings->topology_cache = arg;
+            break;
+        case  15:
+            settings->enable_fused_gather = true;
+            break;
+        case  16:
+            settings->enable_mpi_sessions = true;
+            break;
+        case  17:
+            settings->enable_timings = true;
+            break;
+        case  18:
+            settings->trace_file = arg;
+            break;
+        case   1:
+            settings->output_type = JSON;
+            break;
+        case   2:
+            settings->output_type = JSONL;
+            break;
+        case   3:
+            settings->output_file = arg;
+            break;
+        case   4:
+            settings->save_file = arg;
+            break;
+        case   5:
+            settings->replay_file = arg;
+            break;
+        case   6:
+            settings->diff_files[0] = arg;
+            break;
+        case   7:
+            settings->expect_spec = arg;
+            break;
+        case   8:
+            settings->predict_tasks = atoi(arg);
+            if (settings->predict_tasks <= 0)
+                argp_error(state, "invalid number of tasks '%s' for --predict", arg);
+            break;
+        case   9:
+            settings->predict_topology = arg;
+            break;
+        case ARGP_KEY_ARG:
+            /* Second file of --diff, no other positional argument */
+            if ((settings->diff_files[0] == NULL) || (settings->diff_files[1] != NULL))
+                argp_error(state, "unexpected argument '%s'", arg);
+
+            settings->diff_files[1] = arg;
+            break;
         case  'c':
             settings->color_type = DARK_BG;
             break;
@@ -108,6 +182,39 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
             settings->output_type = YAML;
             break;
         case ARGP_KEY_END:
+            if ((settings->output_file != NULL) && (settings->output_type == STDOUT))
+                argp_error(state, "--output requires --yaml, --json or --jsonl");
+
+            if ((settings->output_file != NULL) && (settings->save_file != NULL))
+                argp_error(state, "--save requires the records on rank 0, it cannot be used with --output");
+
+            if ((settings->diff_files[0] != NULL) && (settings->diff_files[1] == NULL))
+                argp_error(state, "--diff requires two files");
+
+            if ((settings->expect_spec != NULL) && ((settings->output_file != NULL) ||
+                (settings->diff_files[0] != NULL)))
+                argp_error(state, "--expect requires the records on rank 0, it cannot be used with --output or --diff");
+
+            if ((settings->replay_file != NULL) && (settings->diff_files[0] != NULL))
+                argp_error(state, "--replay cannot be used with --diff");
+
+            if (((settings->replay_file != NULL) || (settings->diff_files[0] != NULL)) &&
+                ((settings->output_file != NULL) || (settings->save_file != NULL) ||
+                 (settings->trace_file != NULL) || settings->enable_timings))
+                argp_error(state, "--replay and --diff cannot be used with --output, --save, --timings or --trace");
+
+            if ((settings->predict_topology != NULL) && (settings->predict_tasks == 0))
+                argp_error(state, "--predict-topology requires --predict");
+
+            if ((settings->predict_tasks > 0) &&
+                ((settings->replay_file != NULL) || (settings->diff_files[0] != NULL) ||
+                 (settings->output_file != NULL) || (settings->save_file != NULL) ||
+                 (settings->trace_file != NULL) || settings->enable_timings))
+                argp_error(state, "--predict cannot be used with --replay, --diff, --output, --save, --timings or --trace");
+
+            /* Records are not gathered with a parallel output */
+            if (settings->output_file != NULL)
+                settings->enable_fused_gather = false;
             break;
         default:
             return ARGP_ERR_UNKNOWN;
@@ -129,15 +236,31 @@ static struct argp argp = { options, parse_opt, args_doc, doc };
 void hpcat_settings_init(int argc, char *argv[], HpcatSettings_t *hpcat_settings)
 {
     /* Set defaults and auto-detect */
-    hpcat_settings->output_type    = STDOUT;
-
-    hpcat_settings->enable_accel   = true;
-    hpcat_settings->enable_banner  = true;
-    hpcat_settings->enable_fabric  = true;
-    hpcat_settings->enable_hints   = true;
-    hpcat_settings->enable_nic     = true;
-    hpcat_settings->enable_verbose = false;
-    hpcat_settings->color_type     = NOCOLOR;
+    hpcat_settings->output_type          = STDOUT;
+
+    hpcat_settings->enable_accel         = true;
+    hpcat_settings->enable_accel_runtime = true;
+    hpcat_settings->enable_banner        = true;
+    hpcat_settings->enable_fabric        = true;
+    hpcat_settings->enable_fused_gather  = false;
+    hpcat_settings->enable_hints         = true;
+    hpcat_settings->enable_io_locality   = false;
+    hpcat_settings->enable_mpi_sessions  = false;
+    hpcat_settings->enable_nic           = true;
+    hpcat_settings->enable_partition     = false;
+    hpcat_settings->enable_timings       = false;
+    hpcat_settings->enable_verbose       = false;
+    hpcat_settings->color_type           = NOCOLOR;
+    hpcat_settings->predict_tasks        = 0;
+    hpcat_settings->topology_cache       = NULL;
+    hpcat_settings->trace_file           = NULL;
+    hpcat_settings->diff_files[0]        = NULL;
+    hpcat_settings->diff_files[1]        = NULL;
+    hpcat_settings->expect_spec          = NULL;
+    hpcat_settings->output_file          = NULL;
+    hpcat_settings->predict_topology     = NULL;
+    hpcat_settings->replay_file          = NULL;
+    hpcat_settings->save_file            = NULL;
 
     char *omp_env = getenv("OMP_NUM_THREADS");
     hpcat_settings->enable_omp = (omp_env != NULL) && (atoi(omp_env) > 1);
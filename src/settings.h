@@ -36,7 +36,9 @@
 typedef enum OutputType
 {
     STDOUT,
-    YAML
+    YAML,
+    JSON,
+    JSONL      /* One record per line (rank, thread, summary) */
 } OutputType_t;
 
 typedef enum ColorType
@@ -49,14 +51,29 @@ typedef enum ColorType
 typedef struct HpcatSettings
 {
     bool          enable_accel;
+    bool          enable_accel_runtime;
     bool          enable_banner;
     bool          enable_fabric;
+    bool          enable_fused_gather;
     bool          enable_hints;
+    bool          enable_io_locality;
+    bool          enable_mpi_sessions;
     bool          enable_nic;
     bool          enable_omp;
+    bool          enable_partition;
+    bool          enable_timings;
     bool          enable_verbose;
     ColorType_t   color_type;
     OutputType_t  output_type;
+    int           predict_tasks;   /* --predict, 0 when running the application */
+    char         *diff_files[2];   /* --diff A B */
+    char         *expect_spec;
+    char         *output_file;
+    char         *predict_topology;
+    char         *replay_file;
+    char         *save_file;
+    char         *topology_cache;
+    char         *trace_file;
 } HpcatSettings_t;
 
 void hpcat_settings_init(int argc, char *argv[], HpcatSettings_t *hpcat_settings);
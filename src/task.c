@@ -0,0 +1,438 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* task.c: Variable-size task records, packed for the exchange with rank 0.
+*
+* A packed record is the Task structure (pointers are meaningless once sent)
+* without its accelerator strings, then these strings prefixed by their length,
+* the ulongs of each bitmap in the order of task_bitmaps(), then each Thread
+* structure followed by the ulongs of its own bitmaps. Sizes are read back from
+* the string lengths and the num_ulongs and num_threads fields of the structures.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "task.h"
+#include "common.h"
+
+#define TASK_BITMAPS_MAX   16
+#define THREAD_BITMAPS_MAX  3
+#define TASK_STRINGS_MAX    2
+
+/* Accelerator strings are cut out of the packed Task structure, the PCIe address
+ * list alone is most of it. task_strings() covers this whole area. */
+#define TASK_STRINGS_START  offsetof(Task, accel.pciaddr)
+#define TASK_STRINGS_END    offsetof(Task, accel.numa_affinity)
+#define TASK_HEADER_SIZE    (sizeof(Task) - (TASK_STRINGS_END - TASK_STRINGS_START))
+
+/* Bitmaps of a task, threads excepted */
+static int task_bitmaps(Task *task, Bitmap *bitmaps[TASK_BITMAPS_MAX])
+{
+    int count = 0;
+
+    bitmaps[count++] = &task->affinity.numa_affinity;
+    bitmaps[count++] = &task->affinity.hw_thread_affinity;
+    bitmaps[count++] = &task->affinity.core_affinity;
+    bitmaps[count++] = &task->nic.numa_affinity;
+    bitmaps[count++] = &task->nic.locality.cores;
+    bitmaps[count++] = &task->nic.locality.l3;
+    bitmaps[count++] = &task->accel.numa_affinity;
+    bitmaps[count++] = &task->accel.visible_devices;
+    bitmaps[count++] = &task->accel.locality.cores;
+    bitmaps[count++] = &task->accel.locality.l3;
+
+    return count;
+}
+
+/* Strings of a task packed with their length, and the size of their array */
+static int task_strings(Task *task, char *strings[TASK_STRINGS_MAX], int sizes[TASK_STRINGS_MAX])
+{
+    strings[0] = task->accel.pciaddr;
+    sizes[0] = STR_MAX;
+    strings[1] = task->accel.partition;
+    sizes[1] = PARTITION_LIST_MAX;
+
+    return TASK_STRINGS_MAX;
+}
+
+static int thread_bitmaps(Thread *thread, Bitmap *bitmaps[THREAD_BITMAPS_MAX])
+{
+    bitmaps[0] = &thread->affinity.numa_affinity;
+    bitmaps[1] = &thread->affinity.hw_thread_affinity;
+    bitmaps[2] = &thread->affinity.core_affinity;
+
+    return THREAD_BITMAPS_MAX;
+}
+
+static size_t bitmaps_size(Bitmap **bitmaps, const int count)
+{
+    size_t size = 0;
+
+    for (int i = 0; i < count; i++)
+        size += bitmaps[i]->num_ulongs * sizeof(unsigned long);
+
+    return size;
+}
+
+static size_t strings_size(Task *task)
+{
+    char *strings[TASK_STRINGS_MAX];
+    int sizes[TASK_STRINGS_MAX];
+    size_t size = 0;
+
+    const int count = task_strings(task, strings, sizes);
+    for (int i = 0; i < count; i++)
+        size += sizeof(int) + strnlen(strings[i], sizes[i] - 1);
+
+    return size;
+}
+
+static char *header_pack(char *pos, const Task *task)
+{
+    memcpy(pos, task, TASK_STRINGS_START);
+    memcpy(pos + TASK_STRINGS_START, (const char *)task + TASK_STRINGS_END, sizeof(Task) - TASK_STRINGS_END);
+
+    return pos + TASK_HEADER_SIZE;
+}
+
+static const char *header_unpack(const char *pos, Task *task)
+{
+    memcpy(task, pos, TASK_STRINGS_START);
+    memset((char *)task + TASK_STRINGS_START, 0, TASK_STRINGS_END - TASK_STRINGS_START);
+    memcpy((char *)task + TASK_STRINGS_END, pos + TASK_STRINGS_START, sizeof(Task) - TASK_STRINGS_END);
+
+    return pos + TASK_HEADER_SIZE;
+}
+
+static char *strings_pack(char *pos, Task *task)
+{
+    char *strings[TASK_STRINGS_MAX];
+    int sizes[TASK_STRINGS_MAX];
+
+    const int count = task_strings(task, strings, sizes);
+    for (int i = 0; i < count; i++)
+    {
+        const int len = strnlen(strings[i], sizes[i] - 1);
+        memcpy(pos, &len, sizeof(int));
+        memcpy(pos + sizeof(int), strings[i], len);
+        pos += sizeof(int) + len;
+    }
+
+    return pos;
+}
+
+static const char *strings_unpack(const char *pos, Task *task)
+{
+    char *strings[TASK_STRINGS_MAX];
+    int sizes[TASK_STRINGS_MAX];
+
+    const int count = task_strings(task, strings, sizes);
+    for (int i = 0; i < count; i++)
+    {
+        int len;
+        memcpy(&len, pos, sizeof(int));
+        memcpy(strings[i], pos + sizeof(int), len);
+        strings[i][len] = '\0';
+        pos += sizeof(int) + len;
+    }
+
+    return pos;
+}
+
+static char *bitmaps_pack(char *pos, Bitmap **bitmaps, const int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const size_t size = bitmaps[i]->num_ulongs * sizeof(unsigned long);
+        if (size > 0)
+            memcpy(pos, bitmaps[i]->ulongs, size);
+        pos += size;
+    }
+
+    return pos;
+}
+
+static const char *bitmaps_unpack(const char *pos, Bitmap **bitmaps, const int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const size_t size = bitmaps[i]->num_ulongs * sizeof(unsigned long);
+
+        bitmaps[i]->ulongs = NULL;
+        if (size > 0)
+        {
+            bitmaps[i]->ulongs = malloc(size);
+            if (bitmaps[i]->ulongs == NULL)
+                FATAL("Error: unable to allocate bitmap. Exiting.\n");
+
+            memcpy(bitmaps[i]->ulongs, pos, size);
+        }
+        pos += size;
+    }
+
+    return pos;
+}
+
+/**
+ * Serialize a hwloc bitmap in a task record, growing its storage if needed
+ *
+ * @param   bitmap[inout]   Serialized bitmap
+ * @param   tmp[in]         hwloc bitmap
+ */
+void serialize_bitmap(Bitmap *bitmap, hwloc_bitmap_t tmp)
+{
+    const int num_ulongs = hwloc_bitmap_nr_ulongs(tmp);
+    if (num_ulongs < 0)
+        FATAL("Error: unable to evaluate qty of ulongs needed to serialize the bitmap. Exiting.\n");
+
+    if (num_ulongs > bitmap->num_ulongs)
+    {
+        unsigned long *ulongs = realloc(bitmap->ulongs, num_ulongs * sizeof(unsigned long));
+        if (ulongs == NULL)
+            FATAL("Error: unable to allocate bitmap. Exiting.\n");
+        bitmap->ulongs = ulongs;
+    }
+
+    bitmap->num_ulongs = num_ulongs;
+    if ((num_ulongs > 0) && (hwloc_bitmap_to_ulongs(tmp, bitmap->num_ulongs, bitmap->ulongs) != 0))
+        FATAL("Error: unable to convert bitmap to ulongs. Exiting.\n");
+}
+
+/**
+ * Name of the first NIC selected by MPI
+ *
+ * @param   nic[in]     NIC handle
+ * @param   name[out]   First name of the list (NIC_STR_MAX)
+ */
+void nic_first_name(const Nic *nic, char *name)
+{
+    snprintf(name, NIC_STR_MAX, "%.*s", (int)strcspn(nic->name, ","), nic->name);
+}
+
+/**
+ * Size of a packed task record
+ *
+ * @param   task[in]    Task handle
+ * @return              Size in bytes
+ */
+size_t hpcat_task_pack_size(const Task *task)
+{
+    Bitmap *bitmaps[TASK_BITMAPS_MAX];
+    const int count = task_bitmaps((Task *)task, bitmaps);
+    size_t size = TASK_HEADER_SIZE + strings_size((Task *)task) + bitmaps_size(bitmaps, count);
+
+    for (int i = 0; i < task->num_threads; i++)
+    {
+        const int thread_count = thread_bitmaps(&task->threads[i], bitmaps);
+        size += sizeof(Thread) + bitmaps_size(bitmaps, thread_count);
+    }
+
+    return size;
+}
+
+/* Check the fields of an untrusted record used as indexes or C strings */
+static bool header_is_valid(const Task *task)
+{
+    return (memchr(task->hostname, '\0', HOST_NAME_MAX) != NULL) &&
+           (memchr(task->nic.name, '\0', NIC_LIST_MAX) != NULL) &&
+           (task->fabric_group_id >= 0) && (task->fabric_group_id < FABRIC_GROUPS_MAX);
+}
+
+/* Add the size of packed strings to a record size, false if they go beyond max_size
+ * or do not fit in their array */
+static bool strings_fit(Task *task, const char *start, size_t *size, const size_t max_size)
+{
+    char *strings[TASK_STRINGS_MAX];
+    int sizes[TASK_STRINGS_MAX];
+
+    const int count = task_strings(task, strings, sizes);
+    for (int i = 0; i < count; i++)
+    {
+        int len;
+
+        if (max_size - *size < sizeof(int))
+            return false;
+
+        memcpy(&len, start + *size, sizeof(int));
+        *size += sizeof(int);
+
+        if ((len < 0) || (len >= sizes[i]) || ((size_t)len > max_size - *size))
+            return false;
+
+        *size += len;
+    }
+
+    return true;
+}
+
+/* Add the size of packed bitmaps to a record size, false if they go beyond max_size */
+static bool bitmaps_fit(Bitmap **bitmaps, const int count, size_t *size, const size_t max_size)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if ((bitmaps[i]->num_ulongs < 0) ||
+            ((size_t)bitmaps[i]->num_ulongs > (max_size - *size) / sizeof(unsigned long)))
+            return false;
+
+        *size += bitmaps[i]->num_ulongs * sizeof(unsigned long);
+    }
+
+    return true;
+}
+
+/**
+ * Size of a packed task record read from an untrusted buffer (e.g. a saved file),
+ * bitmaps and threads are sized from the record itself. Records with unterminated
+ * strings or a fabric group out of range are rejected.
+ *
+ * @param   buffer[in]     Packed record
+ * @param   max_size[in]   Size of the buffer
+ * @return                 Size of the record, 0 if it does not fit in the buffer
+ */
+size_t hpcat_task_packed_size(const void *buffer, const size_t max_size)
+{
+    Bitmap *bitmaps[TASK_BITMAPS_MAX];
+    const char *start = buffer;
+    size_t size = TASK_HEADER_SIZE;
+    Task task;
+
+    if (max_size < size)
+        return 0;
+
+    header_unpack(start, &task);
+
+    if (!header_is_valid(&task) || !strings_fit(&task, start, &size, max_size) ||
+        !bitmaps_fit(bitmaps, task_bitmaps(&task, bitmaps), &size, max_size) || (task.num_threads < 0))
+        return 0;
+
+    for (int i = 0; i < task.num_threads; i++)
+    {
+        Thread thread;
+
+        if (max_size - size < sizeof(Thread))
+            return 0;
+
+        memcpy(&thread, start + size, sizeof(Thread));
+        size += sizeof(Thread);
+
+        if (!bitmaps_fit(bitmaps, thread_bitmaps(&thread, bitmaps), &size, max_size))
+            return 0;
+    }
+
+    return size;
+}
+
+/**
+ * Pack a task record in a contiguous buffer
+ *
+ * @param   task[in]      Task handle
+ * @param   buffer[out]   Buffer of hpcat_task_pack_size() bytes
+ */
+void hpcat_task_pack(const Task *task, void *buffer)
+{
+    Bitmap *bitmaps[TASK_BITMAPS_MAX];
+    char *pos = buffer;
+
+    pos = header_pack(pos, task);
+    pos = strings_pack(pos, (Task *)task);
+
+    int count = task_bitmaps((Task *)task, bitmaps);
+    pos = bitmaps_pack(pos, bitmaps, count);
+
+    for (int i = 0; i < task->num_threads; i++)
+    {
+        memcpy(pos, &task->threads[i], sizeof(Thread));
+        pos += sizeof(Thread);
+
+        count = thread_bitmaps(&task->threads[i], bitmaps);
+        pos = bitmaps_pack(pos, bitmaps, count);
+    }
+}
+
+/**
+ * Rebuild a task record from a packed buffer, release it with hpcat_task_free()
+ *
+ * @param   task[out]     Task handle
+ * @param   buffer[in]    Packed record
+ */
+void hpcat_task_unpack(Task *task, const void *buffer)
+{
+    Bitmap *bitmaps[TASK_BITMAPS_MAX];
+    const char *pos = buffer;
+
+    pos = header_unpack(pos, task);
+    pos = strings_unpack(pos, task);
+
+    int count = task_bitmaps(task, bitmaps);
+    pos = bitmaps_unpack(pos, bitmaps, count);
+
+    task->threads = NULL;
+    if (task->num_threads == 0)
+        return;
+
+    task->threads = malloc(task->num_threads * sizeof(Thread));
+    if (task->threads == NULL)
+        FATAL("Error: unable to allocate threads buffer. Exiting.\n");
+
+    for (int i = 0; i < task->num_threads; i++)
+    {
+        memcpy(&task->threads[i], pos, sizeof(Thread));
+        pos += sizeof(Thread);
+
+        count = thread_bitmaps(&task->threads[i], bitmaps);
+        pos = bitmaps_unpack(pos, bitmaps, count);
+    }
+}
+
+/**
+ * Release the memory of a task record (not the record itself)
+ *
+ * @param   task[inout]   Task handle
+ */
+void hpcat_task_free(Task *task)
+{
+    Bitmap *bitmaps[TASK_BITMAPS_MAX];
+
+    for (int i = 0; i < task->num_threads; i++)
+    {
+        const int count = thread_bitmaps(&task->threads[i], bitmaps);
+        for (int j = 0; j < count; j++)
+            free(bitmaps[j]->ulongs);
+    }
+
+    free(task->threads);
+    task->threads = NULL;
+    task->num_threads = 0;
+
+    const int count = task_bitmaps(task, bitmaps);
+    for (int i = 0; i < count; i++)
+    {
+        free(bitmaps[i]->ulongs);
+        bitmaps[i]->ulongs = NULL;
+        bitmaps[i]->num_ulongs = 0;
+    }
+}
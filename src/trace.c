@@ -0,0 +1,204 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* trace.c: Timeline of all ranks in the Chrome trace event format (--trace).
+*
+* Each rank records its probes and collectives, events are gathered by rank 0
+* after the task records and written as a JSON file loadable in Perfetto or
+* chrome://tracing: one process per node, one thread per rank.
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "trace.h"
+#include "common.h"
+
+static const char * const category_str[] =
+{
+    [TRACE_PHASE]      = "probe",
+    [TRACE_COLLECTIVE] = "collective",
+};
+
+/**
+ * Record an event of this rank (no-op without --trace)
+ *
+ * @param   hpcat[inout]   Application handle
+ * @param   name[in]       Event name
+ * @param   category[in]   Probe or collective
+ * @param   start[in]      Start time (monotonic clock, seconds)
+ * @param   end[in]        End time (monotonic clock, seconds)
+ */
+void hpcat_trace_add(Hpcat *hpcat, const char *name, const TraceCategory_t category,
+                     const double start, const double end)
+{
+    if (hpcat->settings.trace_file == NULL)
+        return;
+
+    if (array_grow(&hpcat->trace, &hpcat->trace_capacity, hpcat->num_trace_events, sizeof(TraceEvent)) != 0)
+        FATAL("Error: unable to allocate trace events. Exiting.\n");
+
+    TraceEvent *event = &hpcat->trace[hpcat->num_trace_events++];
+    snprintf(event->name, TRACE_NAME_MAX, "%s", name);
+    event->category = category;
+    event->start = start + hpcat->clock_offset;
+    event->end = end + hpcat->clock_offset;
+}
+
+/**
+ * Gather the events of traced ranks on rank 0 (collective)
+ *
+ * @param   hpcat[in]     Application handle
+ * @param   counts[out]   Rank 0: number of events of each rank
+ * @return                Rank 0: events of all ranks in rank order, others: NULL
+ */
+TraceEvent *hpcat_trace_gather(Hpcat *hpcat, int **counts)
+{
+    const bool is_root = (hpcat->id == 0);
+    const int count = hpcat->is_traced ? hpcat->num_trace_events : 0;
+    int *sizes = NULL, *displs = NULL;
+    TraceEvent *events = NULL;
+
+    *counts = NULL;
+    if (is_root)
+    {
+        *counts = malloc(hpcat->num_tasks * sizeof(int));
+        sizes = malloc(hpcat->num_tasks * sizeof(int));
+        displs = malloc(hpcat->num_tasks * sizeof(int));
+        if ((*counts == NULL) || (sizes == NULL) || (displs == NULL))
+            FATAL("Error: unable to allocate trace buffers. Exiting.\n");
+    }
+
+    MPI_CHECK( MPI_Gather(&count, 1, MPI_INT, *counts, 1, MPI_INT, 0, hpcat->comm) );
+
+    if (is_root)
+    {
+        size_t total = 0;
+        for (int i = 0; i < hpcat->num_tasks; i++)
+        {
+            if (total + (*counts)[i] * sizeof(TraceEvent) > INT_MAX)
+                FATAL("Error: trace events exceed the size of a gather. Exiting.\n");
+
+            displs[i] = (int)total;
+            sizes[i] = (*counts)[i] * sizeof(TraceEvent);
+            total += sizes[i];
+        }
+
+        events = malloc(total > 0 ? total : 1);
+        if (events == NULL)
+            FATAL("Error: unable to allocate trace events. Exiting.\n");
+    }
+
+    MPI_CHECK( MPI_Gatherv(hpcat->trace, count * sizeof(TraceEvent), MPI_BYTE, events, sizes, displs,
+                           MPI_BYTE, 0, hpcat->comm) );
+
+    free(sizes);
+    free(displs);
+
+    return events;
+}
+
+static void write_event(FILE *file, const TraceEvent *event, const double origin, const int pid,
+                        const int tid, bool *is_first)
+{
+    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                  "\"pid\":%d,\"tid\":%d}", *is_first ? "" : ",", event->name, category_str[event->category],
+            (event->start - origin) * 1e6, (event->end - event->start) * 1e6, pid, tid);
+    *is_first = false;
+}
+
+/**
+ * Write the trace file (rank 0, after the render). Events of rank 0 are taken from
+ * its own record, which also holds the steps following the gather.
+ *
+ * @param   hpcat[in]             Application handle
+ * @param   events[in]            Gathered events
+ * @param   counts[in]            Number of events of each rank
+ * @param   reordered_ranks[in]   Ranks ordered by node
+ * @param   is_first_node_rank[in] First rank of its node, indexed by rank
+ */
+void hpcat_trace_write(Hpcat *hpcat, const TraceEvent *events, const int *counts,
+                       const int *reordered_ranks, const bool *is_first_node_rank)
+{
+    FILE *file = fopen(hpcat->settings.trace_file, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Warning: unable to write the trace in %s.\n", hpcat->settings.trace_file);
+        return;
+    }
+
+    int *offsets = malloc(hpcat->num_tasks * sizeof(int));
+    int *nodes = malloc(hpcat->num_tasks * sizeof(int));
+    if ((offsets == NULL) || (nodes == NULL))
+        FATAL("Error: unable to allocate trace buffers. Exiting.\n");
+
+    /* Timestamps are relative to the first event of the job */
+    double origin = (hpcat->num_trace_events > 0) ? hpcat->trace[0].start : 0.0;
+    for (int i = 0, offset = 0; i < hpcat->num_tasks; offset += counts[i], i++)
+    {
+        offsets[i] = offset;
+        for (int j = 0; j < counts[i]; j++)
+            if (events[offset + j].start < origin)
+                origin = events[offset + j].start;
+    }
+
+    /* One process per node, named after its host */
+    bool is_first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for (int i = 0, node = -1; i < hpcat->num_tasks; i++)
+    {
+        const int rank = reordered_ranks[i];
+
+        if (is_first_node_rank[rank] || (node < 0))
+        {
+            node++;
+            fprintf(file, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    is_first ? "" : ",", node, hpcat->host_map[rank]);
+            is_first = false;
+        }
+        nodes[rank] = node;
+
+        if ((counts[rank] > 0) || (rank == 0))
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                          "\"args\":{\"name\":\"rank %d\"}}", node, rank, rank);
+    }
+
+    for (int rank = 0; rank < hpcat->num_tasks; rank++)
+    {
+        const TraceEvent *rank_events = (rank == 0) ? hpcat->trace : &events[offsets[rank]];
+        const int count = (rank == 0) ? hpcat->num_trace_events : counts[rank];
+
+        for (int j = 0; j < count; j++)
+            write_event(file, &rank_events[j], origin, nodes[rank], rank, &is_first);
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    free(offsets);
+    free(nodes);
+}
@@ -0,0 +1,41 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* hpcat: display NUMA and CPU affinities in the context of HPC applications
+* trace.h: Timeline of all ranks in the Chrome trace event format (--trace)
+*
+* URL       https://github.com/HewlettPackard/hpcat
+******************************************************************************/
+
+#ifndef HPCAT_TRACE_H
+#define HPCAT_TRACE_H
+
+#include "hpcat.h"
+
+#define TRACE_RANKS_MAX  1024   /* Above, only node leaders and sampled ranks are traced */
+
+void hpcat_trace_add(Hpcat *hpcat, const char *name, const TraceCategory_t category,
+                     const double start, const double end);
+TraceEvent *hpcat_trace_gather(Hpcat *hpcat, int **counts);
+void hpcat_trace_write(Hpcat *hpcat, const TraceEvent *events, const int *counts,
+                       const int *reordered_ranks, const bool *is_first_node_rank);
+
+#endif /* HPCAT_TRACE_H */